@@ -0,0 +1,375 @@
+#ifndef ARFFARROW_HPP
+#define ARFFARROW_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include "ArffDataset.hpp"
+
+//
+// Arrow C Data Interface (https://arrow.apache.org/docs/format/CDataInterface.html), the structs
+// are defined here unless a header of Arrow or nanoarrow has already done it
+//
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+#endif
+
+//
+// Hands an ArffDataset to Arrow consumers (DuckDB, Polars, pyarrow...) as a struct array with a
+// column per attribute and the class last, and builds one back from Arrow data.
+// Numeric columns are float32 pointing into X and the class indices point into y, so they aren't
+// copied; the exported structs keep the dataset alive until the last of them is released.
+// Nominal columns are dictionary encoded, int32 codes over a utf8 dictionary of the values as read.
+// Importing takes float, integer, string and dictionary columns and drops the rows with nulls,
+// as the loader drops the rows with missing values
+//
+class ArffArrow {
+public:
+    // Fills schema and array, the caller releases both
+    static void exportDataset(const std::shared_ptr<const ArffDataset>& dataset, ArrowSchema* schema, ArrowArray* array)
+    {
+        const auto& attributes = dataset->getAttributes();
+        const auto& dictionaries = dataset->getDictionaries();
+        const size_t columns = attributes.size() + 1;
+        const auto rows = static_cast<int64_t>(dataset->getSize());
+        auto data = std::make_shared<Export>();
+        data->dataset = dataset;
+        data->columns.resize(columns);
+        for (size_t i = 0; i < columns; i++) {
+            auto& column = data->columns[i];
+            bool isClass = i == attributes.size();
+            column.name = isClass ? dataset->getClassName() : attributes[i].first;
+            if (!isClass && dataset->getNumericAttributes().at(column.name)) {
+                column.format = "f";
+                column.buffers = { nullptr, dataset->getX()[i].data() };
+                continue;
+            }
+            column.format = "i";
+            if (isClass) {
+                static_assert(sizeof(int) == sizeof(int32_t), "y is exported as int32");
+                column.buffers = { nullptr, dataset->getY().data() };
+            } else {
+                column.codes.assign(dataset->getX()[i].begin(), dataset->getX()[i].end());
+                column.buffers = { nullptr, column.codes.data() };
+            }
+            const auto& values = dictionaries.at(column.name);
+            column.offsets.push_back(0);
+            for (const auto& value : values) {
+                column.characters += value;
+                column.offsets.push_back(static_cast<int32_t>(column.characters.size()));
+            }
+            column.dictionaryBuffers = { nullptr, column.offsets.data(), column.characters.data() };
+        }
+        // The structs of the columns live in data, the pointers to them don't move from here on
+        data->schemas.resize(columns);
+        data->arrays.resize(columns);
+        data->dictionarySchemas.resize(columns);
+        data->dictionaryArrays.resize(columns);
+        for (size_t i = 0; i < columns; i++) {
+            const auto& column = data->columns[i];
+            auto& childSchema = data->schemas[i];
+            auto& childArray = data->arrays[i];
+            childSchema = makeSchema(data, column.format, column.name.c_str(), 0, nullptr);
+            childArray = makeArray(data, rows, column.buffers, 0, nullptr);
+            if (!column.dictionaryBuffers.empty()) {
+                data->dictionarySchemas[i] = makeSchema(data, "u", "", 0, nullptr);
+                data->dictionaryArrays[i] = makeArray(data, static_cast<int64_t>(column.offsets.size() - 1), column.dictionaryBuffers, 0, nullptr);
+                childSchema.dictionary = &data->dictionarySchemas[i];
+                childArray.dictionary = &data->dictionaryArrays[i];
+            }
+            data->schemaPointers.push_back(&childSchema);
+            data->arrayPointers.push_back(&childArray);
+        }
+        *schema = makeSchema(data, "+s", "", static_cast<int64_t>(columns), data->schemaPointers.data());
+        schema->flags = 0;
+        *array = makeArray(data, rows, data->rootBuffers, static_cast<int64_t>(columns), data->arrayPointers.data());
+    }
+    // Builds a dataset from a struct array, the class is the column named className or the last one.
+    // Takes ownership of schema and array and releases them
+    static std::shared_ptr<const ArffDataset> importDataset(ArrowSchema* schema, ArrowArray* array, const std::string& className = "")
+    {
+        struct Release {
+            ArrowSchema* schema;
+            ArrowArray* array;
+            ~Release()
+            {
+                if (array->release)
+                    array->release(array);
+                if (schema->release)
+                    schema->release(schema);
+            }
+        } release{ schema, array };
+        if (std::string(schema->format) != "+s" || schema->n_children != array->n_children) {
+            throw std::invalid_argument("Arrow input must be a struct array");
+        }
+        if (schema->n_children < 2) {
+            throw std::invalid_argument("No attributes found");
+        }
+        int64_t labelIndex = schema->n_children - 1;
+        if (!className.empty()) {
+            labelIndex = -1;
+            for (int64_t i = 0; i < schema->n_children; i++) {
+                if (schema->children[i]->name != nullptr && className == schema->children[i]->name)
+                    labelIndex = i;
+            }
+            if (labelIndex < 0) {
+                throw std::invalid_argument("Class name not found");
+            }
+        }
+        const int64_t rows = array->length;
+        std::vector<bool> keep(rows, true);
+        for (int64_t i = 0; i < schema->n_children; i++) {
+            const auto* child = array->children[i];
+            const auto* validity = static_cast<const uint8_t*>(child->buffers[0]);
+            if (child->null_count == 0 || validity == nullptr)
+                continue;
+            for (int64_t row = 0; row < rows; row++) {
+                int64_t bit = array->offset + child->offset + row;
+                if ((validity[bit / 8] & (1 << (bit % 8))) == 0)
+                    keep[row] = false;
+            }
+        }
+        std::vector<std::pair<std::string, std::string>> attributes;
+        std::map<std::string, bool> numeric_features;
+        std::vector<std::vector<float>> X;
+        std::vector<int> y;
+        std::map<std::string, std::vector<std::string>> dictionaries;
+        std::string labelName;
+        std::string labelType;
+        for (int64_t i = 0; i < schema->n_children; i++) {
+            const auto* childSchema = schema->children[i];
+            const auto* child = array->children[i];
+            std::string name = childSchema->name == nullptr ? "" : childSchema->name;
+            const int64_t offset = array->offset + child->offset;
+            std::vector<std::string> values;
+            std::vector<int> codes;
+            bool isClass = i == labelIndex;
+            if (!readNominal(childSchema, child, offset, rows, keep, isClass, values, codes)) {
+                if (isClass) {
+                    throw std::invalid_argument("The class must be a string, dictionary or integer column");
+                }
+                attributes.emplace_back(name, "numeric");
+                numeric_features[name] = true;
+                X.push_back(readNumeric(childSchema->format, child, offset, rows, keep));
+                continue;
+            }
+            std::string type = "{";
+            for (size_t j = 0; j < values.size(); j++) {
+                type += (j > 0 ? "," : "") + values[j];
+            }
+            type += "}";
+            if (isClass) {
+                labelName = name;
+                labelType = type;
+                y = std::move(codes);
+            } else {
+                attributes.emplace_back(name, type);
+                numeric_features[name] = false;
+                X.emplace_back(codes.begin(), codes.end());
+            }
+            dictionaries[name] = std::move(values);
+        }
+        std::map<std::string, std::vector<std::string>> states;
+        for (const auto& attribute : attributes) {
+            states[attribute.first];
+        }
+        for (const auto& [name, values] : dictionaries) {
+            auto& featureStates = states[name];
+            for (const auto& value : values) {
+                bool allDigits = std::all_of(value.begin(), value.end(), ::isdigit);
+                featureStates.push_back(allDigits ? "Class " + value : value);
+            }
+        }
+        return std::make_shared<const ArffDataset>(std::move(attributes), std::move(numeric_features), labelName, labelType, std::move(X),
+            std::move(y), std::move(states), std::move(dictionaries));
+    }
+private:
+    struct Column {
+        std::string name;
+        const char* format;
+        std::vector<const void*> buffers;
+        std::vector<int32_t> codes;
+        std::vector<int32_t> offsets;
+        std::string characters;
+        std::vector<const void*> dictionaryBuffers;
+    };
+    // Everything the exported structs point to, freed with the last of them
+    struct Export {
+        std::shared_ptr<const ArffDataset> dataset;
+        std::vector<Column> columns;
+        std::vector<ArrowSchema> schemas;
+        std::vector<ArrowArray> arrays;
+        std::vector<ArrowSchema> dictionarySchemas;
+        std::vector<ArrowArray> dictionaryArrays;
+        std::vector<ArrowSchema*> schemaPointers;
+        std::vector<ArrowArray*> arrayPointers;
+        std::vector<const void*> rootBuffers{ nullptr };
+    };
+    using Handle = std::shared_ptr<Export>;
+    static ArrowSchema makeSchema(const Handle& data, const char* format, const char* name, int64_t children, ArrowSchema** pointers)
+    {
+        return ArrowSchema{ format, name, nullptr, ARROW_FLAG_NULLABLE, children, pointers, nullptr, releaseSchema, new Handle(data) };
+    }
+    static ArrowArray makeArray(const Handle& data, int64_t length, const std::vector<const void*>& buffers, int64_t children, ArrowArray** pointers)
+    {
+        return ArrowArray{ length, 0, 0, static_cast<int64_t>(buffers.size()), children, const_cast<const void**>(buffers.data()), pointers, nullptr,
+            releaseArray, new Handle(data) };
+    }
+    // Children moved out by the consumer are already marked released
+    static void releaseSchema(ArrowSchema* schema)
+    {
+        for (int64_t i = 0; i < schema->n_children; i++) {
+            if (schema->children[i]->release)
+                schema->children[i]->release(schema->children[i]);
+        }
+        if (schema->dictionary != nullptr && schema->dictionary->release)
+            schema->dictionary->release(schema->dictionary);
+        delete static_cast<Handle*>(schema->private_data);
+        schema->release = nullptr;
+    }
+    static void releaseArray(ArrowArray* array)
+    {
+        for (int64_t i = 0; i < array->n_children; i++) {
+            if (array->children[i]->release)
+                array->children[i]->release(array->children[i]);
+        }
+        if (array->dictionary != nullptr && array->dictionary->release)
+            array->dictionary->release(array->dictionary);
+        delete static_cast<Handle*>(array->private_data);
+        array->release = nullptr;
+    }
+    static bool isInteger(char format) { return std::string("csilCSIL").find(format) != std::string::npos; }
+    template <typename T, typename Output>
+    static void readValues(const void* buffer, int64_t offset, int64_t rows, const std::vector<bool>& keep, Output& output)
+    {
+        const auto* values = static_cast<const T*>(buffer) + offset;
+        for (int64_t row = 0; row < rows; row++) {
+            if (keep[row])
+                output.push_back(static_cast<typename Output::value_type>(values[row]));
+        }
+    }
+    template <typename Output>
+    static void readIntegers(char format, const void* buffer, int64_t offset, int64_t rows, const std::vector<bool>& keep, Output& output)
+    {
+        switch (format) {
+            case 'c': readValues<int8_t>(buffer, offset, rows, keep, output); break;
+            case 's': readValues<int16_t>(buffer, offset, rows, keep, output); break;
+            case 'i': readValues<int32_t>(buffer, offset, rows, keep, output); break;
+            case 'l': readValues<int64_t>(buffer, offset, rows, keep, output); break;
+            case 'C': readValues<uint8_t>(buffer, offset, rows, keep, output); break;
+            case 'S': readValues<uint16_t>(buffer, offset, rows, keep, output); break;
+            case 'I': readValues<uint32_t>(buffer, offset, rows, keep, output); break;
+            case 'L': readValues<uint64_t>(buffer, offset, rows, keep, output); break;
+        }
+    }
+    static std::vector<float> readNumeric(const char* format, const ArrowArray* array, int64_t offset, int64_t rows, const std::vector<bool>& keep)
+    {
+        std::vector<float> result;
+        result.reserve(rows);
+        if (std::string(format) == "f") {
+            readValues<float>(array->buffers[1], offset, rows, keep, result);
+        } else if (std::string(format) == "g") {
+            readValues<double>(array->buffers[1], offset, rows, keep, result);
+        } else if (format[1] == '\0' && isInteger(format[0])) {
+            readIntegers(format[0], array->buffers[1], offset, rows, keep, result);
+        } else {
+            throw std::invalid_argument("Unsupported Arrow format: " + std::string(format));
+        }
+        return result;
+    }
+    // Values of a utf8 ("u") or large utf8 ("U") array
+    static std::vector<std::string> readStrings(const char* format, const ArrowArray* array, int64_t offset, int64_t count)
+    {
+        std::vector<std::string> result;
+        const auto* characters = static_cast<const char*>(array->buffers[2]);
+        for (int64_t i = 0; i < count; i++) {
+            int64_t begin, end;
+            if (std::string(format) == "u") {
+                const auto* offsets = static_cast<const int32_t*>(array->buffers[1]) + offset;
+                begin = offsets[i];
+                end = offsets[i + 1];
+            } else if (std::string(format) == "U") {
+                const auto* offsets = static_cast<const int64_t*>(array->buffers[1]) + offset;
+                begin = offsets[i];
+                end = offsets[i + 1];
+            } else {
+                throw std::invalid_argument("Unsupported Arrow format: " + std::string(format));
+            }
+            result.emplace_back(characters + begin, characters + end);
+        }
+        return result;
+    }
+    // Dictionary and string columns, and integer ones for the class. Codes follow the dictionary order
+    // or the first appearance of the values
+    static bool readNominal(const ArrowSchema* schema, const ArrowArray* array, int64_t offset, int64_t rows, const std::vector<bool>& keep,
+        bool integers, std::vector<std::string>& values, std::vector<int>& codes)
+    {
+        const std::string format = schema->format;
+        if (schema->dictionary != nullptr) {
+            if (format.size() != 1 || !isInteger(format[0])) {
+                throw std::invalid_argument("Unsupported Arrow dictionary index: " + format);
+            }
+            const auto* dictionary = array->dictionary;
+            values = readStrings(schema->dictionary->format, dictionary, dictionary->offset, dictionary->length);
+            readIntegers(format[0], array->buffers[1], offset, rows, keep, codes);
+            return true;
+        }
+        std::vector<std::string> labels;
+        if (format == "u" || format == "U") {
+            auto all = readStrings(format.c_str(), array, offset, rows);
+            for (int64_t row = 0; row < rows; row++) {
+                if (keep[row])
+                    labels.push_back(std::move(all[row]));
+            }
+        } else if (integers && format.size() == 1 && isInteger(format[0])) {
+            std::vector<int64_t> numbers;
+            readIntegers(format[0], array->buffers[1], offset, rows, keep, numbers);
+            for (auto number : numbers) {
+                labels.push_back(std::to_string(number));
+            }
+        } else {
+            return false;
+        }
+        std::unordered_map<std::string, int> labelMap;
+        for (const auto& label : labels) {
+            auto found = labelMap.emplace(label, static_cast<int>(values.size()));
+            if (found.second)
+                values.push_back(label);
+            codes.push_back(found.first->second);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef ARFFCACHE_HPP
+#define ARFFCACHE_HPP
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+#include <stdexcept>
+#include "ArffFiles.hpp"
+
+//
+// Settings of ArffFiles that change the dataset loaded, part of the key of ArffCache. The rest
+// (statistics, sketches, histograms, threads and reading) don't end up in the dataset
+//
+struct ArffLoadOptions {
+    ArffSampling sampling = ArffSampling::None;
+    size_t sampleRows = 0;
+    uint64_t sampleSeed = 0;
+    bool deduplicate = false;
+    ArffScaling scaling = ArffScaling::None;
+    void apply(ArffFiles& arff) const
+    {
+        arff.setSampling(sampling, sampleRows, sampleSeed);
+        arff.setDeduplicate(deduplicate);
+        arff.setScaling(scaling);
+    }
+    std::string key() const
+    {
+        return std::to_string(static_cast<int>(sampling)) + ',' + std::to_string(sampleRows) + ',' + std::to_string(sampleSeed) + ','
+            + std::to_string(deduplicate) + ',' + std::to_string(static_cast<int>(scaling));
+    }
+};
+
+//
+// Loaded datasets kept by path, size, modification time, class attribute and load options, so loading
+// a file again while it's unchanged hands out the same dataset instead of parsing it. The datasets are
+// shared and can't be modified. When the memory they take goes over the budget the least recently
+// used ones are dropped, a dataset bigger than the whole budget is returned without keeping it
+//
+class ArffCache {
+public:
+    explicit ArffCache(size_t budgetBytes = size_t(1) << 30) : budget(budgetBytes) {}
+    ArffCache(const ArffCache&) = delete;
+    ArffCache& operator=(const ArffCache&) = delete;
+    // Shared by the whole process
+    static ArffCache& instance()
+    {
+        static ArffCache cache;
+        return cache;
+    }
+    std::shared_ptr<const ArffDataset> load(const std::string& fileName, bool classLast = true, const ArffLoadOptions& options = ArffLoadOptions())
+    {
+        return get(fileName, classLast ? "\x01last" : "\x01first", options, [&](ArffFiles& arff) { arff.load(fileName, classLast); });
+    }
+    std::shared_ptr<const ArffDataset> load(const std::string& fileName, const std::string& name, const ArffLoadOptions& options = ArffLoadOptions())
+    {
+        return get(fileName, name, options, [&](ArffFiles& arff) { arff.load(fileName, name); });
+    }
+    std::shared_ptr<const ArffDataset> load(const std::string& fileName, const std::vector<std::string>& targets, const ArffLoadOptions& options = ArffLoadOptions())
+    {
+        std::string spec = "\x01targets";
+        for (const auto& target : targets) {
+            spec += '\x02' + target;
+        }
+        return get(fileName, spec, options, [&](ArffFiles& arff) { arff.load(fileName, targets); });
+    }
+    void setBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        evict();
+    }
+    size_t getBudget() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return budget;
+    }
+    // Bytes taken by the datasets kept
+    size_t getUsage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return usage;
+    }
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    size_t getHits() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+    size_t getMisses() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return misses;
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        usage = 0;
+    }
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const ArffDataset> dataset;
+        size_t bytes;
+    };
+    template <typename Loader>
+    std::shared_ptr<const ArffDataset> get(const std::string& fileName, const std::string& classSpec, const ArffLoadOptions& options, Loader loader)
+    {
+        auto stamp = fileStamp(fileName);
+        if (stamp.empty()) {
+            throw std::invalid_argument("Unable to open file");
+        }
+        auto key = stamp + '\0' + classSpec + '\0' + options.key();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if (found != index.end()) {
+                hits++;
+                entries.splice(entries.begin(), entries, found->second);
+                return found->second->dataset;
+            }
+            misses++;
+        }
+        // Parsed without the lock, concurrent misses of the same file keep the first one stored
+        ArffFiles arff;
+        options.apply(arff);
+        loader(arff);
+        auto dataset = arff.releaseDataset();
+        size_t bytes = dataset->getMemoryUsage();
+        // Changed while it was being loaded, the dataset may not match the key
+        if (fileStamp(fileName) != stamp) {
+            return dataset;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found != index.end()) {
+            entries.splice(entries.begin(), entries, found->second);
+            return found->second->dataset;
+        }
+        if (bytes > budget) {
+            return dataset;
+        }
+        entries.push_front(Entry{ key, dataset, bytes });
+        index[key] = entries.begin();
+        usage += bytes;
+        evict();
+        return dataset;
+    }
+    void evict()
+    {
+        while (usage > budget && !entries.empty()) {
+            usage -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+    // Path, size and modification time of the file, empty if it can't be read
+    static std::string fileStamp(const std::string& fileName)
+    {
+        std::error_code error;
+        auto path = std::filesystem::absolute(fileName, error);
+        auto fileSize = std::filesystem::file_size(path, error);
+        if (error) {
+            return "";
+        }
+        auto modified = std::filesystem::last_write_time(path, error);
+        if (error) {
+            return "";
+        }
+        return path.lexically_normal().string() + '\0' + std::to_string(fileSize) + '\0' + std::to_string(modified.time_since_epoch().count());
+    }
+    mutable std::mutex mutex;
+    size_t budget;
+    size_t usage = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef ARFFCONTINGENCY_HPP
+#define ARFFCONTINGENCY_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include "ArffParallel.hpp"
+
+//
+// Joint counts of two columns of codes, such as a nominal attribute of X (codes stored as floats) and
+// y. Counting first turns a block of rows into cell numbers, a loop the compiler vectorizes, and then
+// spreads the increments over four copies of the table, so runs of the same cell don't wait on each
+// other's stores. Mutual information and chi-square come from the counts
+//
+class ArffContingency {
+public:
+    ArffContingency() = default;
+    ArffContingency(size_t rows, size_t columns) : numRows(rows), numColumns(columns), counts(rows * columns, 0) {}
+    // Codes of a must be below aStates and codes of b below bStates
+    template <typename A, typename B>
+    static ArffContingency of(const A* a, size_t aStates, const B* b, size_t bStates, size_t size)
+    {
+        ArffContingency table(aStates, bStates);
+        const size_t cells = aStates * bStates;
+        if (cells == 0 || size == 0)
+            return table;
+        if (cells > std::numeric_limits<uint32_t>::max() / 4) {
+            throw std::invalid_argument("The contingency table is too big");
+        }
+        const auto aLimit = static_cast<uint32_t>(aStates);
+        const auto bLimit = static_cast<uint32_t>(bStates);
+        std::vector<uint32_t> partial(cells * lanes, 0);
+        std::vector<uint32_t> index(blockRows);
+        size_t sinceFlush = 0;
+        for (size_t first = 0; first < size; first += blockRows) {
+            const size_t rows = std::min(blockRows, size - first);
+            uint32_t invalid = 0;
+            for (size_t i = 0; i < rows; i++) {
+                auto x = static_cast<uint32_t>(static_cast<int32_t>(a[first + i]));
+                auto y = static_cast<uint32_t>(static_cast<int32_t>(b[first + i]));
+                invalid |= static_cast<uint32_t>(x >= aLimit) | static_cast<uint32_t>(y >= bLimit);
+                index[i] = x * bLimit + y;
+            }
+            if (invalid) {
+                throw std::invalid_argument("Codes must be below the number of states");
+            }
+            size_t i = 0;
+            for (; i + lanes <= rows; i += lanes) {
+                partial[index[i]]++;
+                partial[cells + index[i + 1]]++;
+                partial[2 * cells + index[i + 2]]++;
+                partial[3 * cells + index[i + 3]]++;
+            }
+            for (; i < rows; i++)
+                partial[index[i]]++;
+            // Before any 32 bit count could overflow
+            sinceFlush += rows;
+            if (sinceFlush >= (size_t(1) << 31)) {
+                table.add(partial);
+                sinceFlush = 0;
+            }
+        }
+        table.add(partial);
+        return table;
+    }
+    size_t rows() const { return numRows; }
+    size_t columns() const { return numColumns; }
+    uint64_t operator()(size_t row, size_t column) const { return counts[row * numColumns + column]; }
+    const std::vector<uint64_t>& getCounts() const { return counts; }
+    uint64_t total() const
+    {
+        uint64_t sum = 0;
+        for (auto count : counts)
+            sum += count;
+        return sum;
+    }
+    std::vector<uint64_t> rowTotals() const
+    {
+        std::vector<uint64_t> totals(numRows, 0);
+        for (size_t row = 0; row < numRows; row++) {
+            for (size_t column = 0; column < numColumns; column++)
+                totals[row] += (*this)(row, column);
+        }
+        return totals;
+    }
+    std::vector<uint64_t> columnTotals() const
+    {
+        std::vector<uint64_t> totals(numColumns, 0);
+        for (size_t row = 0; row < numRows; row++) {
+            for (size_t column = 0; column < numColumns; column++)
+                totals[column] += (*this)(row, column);
+        }
+        return totals;
+    }
+    // In nats
+    double mutualInformation() const
+    {
+        const double n = static_cast<double>(total());
+        if (n == 0)
+            return 0;
+        auto rowSums = rowTotals();
+        auto columnSums = columnTotals();
+        double result = 0;
+        for (size_t row = 0; row < numRows; row++) {
+            for (size_t column = 0; column < numColumns; column++) {
+                double joint = static_cast<double>((*this)(row, column));
+                if (joint == 0)
+                    continue;
+                result += joint / n * std::log(joint * n / (static_cast<double>(rowSums[row]) * static_cast<double>(columnSums[column])));
+            }
+        }
+        return std::max(result, 0.0);
+    }
+    // Pearson's statistic of independence, states never seen are left out
+    double chiSquare() const
+    {
+        const double n = static_cast<double>(total());
+        if (n == 0)
+            return 0;
+        auto rowSums = rowTotals();
+        auto columnSums = columnTotals();
+        double result = 0;
+        for (size_t row = 0; row < numRows; row++) {
+            for (size_t column = 0; column < numColumns; column++) {
+                double expected = static_cast<double>(rowSums[row]) * static_cast<double>(columnSums[column]) / n;
+                if (expected == 0)
+                    continue;
+                double difference = static_cast<double>((*this)(row, column)) - expected;
+                result += difference * difference / expected;
+            }
+        }
+        return result;
+    }
+    // (rows seen - 1) * (columns seen - 1)
+    size_t degreesOfFreedom() const
+    {
+        auto seen = [](const std::vector<uint64_t>& totals) {
+            return static_cast<size_t>(std::count_if(totals.begin(), totals.end(), [](uint64_t total) { return total > 0; }));
+        };
+        size_t rowsSeen = seen(rowTotals());
+        size_t columnsSeen = seen(columnTotals());
+        return rowsSeen > 0 && columnsSeen > 0 ? (rowsSeen - 1) * (columnsSeen - 1) : 0;
+    }
+private:
+    static constexpr size_t lanes = 4;
+    static constexpr size_t blockRows = 4096;
+    void add(std::vector<uint32_t>& partial)
+    {
+        const size_t cells = counts.size();
+        for (size_t lane = 0; lane < lanes; lane++) {
+            for (size_t cell = 0; cell < cells; cell++)
+                counts[cell] += partial[lane * cells + cell];
+        }
+        std::fill(partial.begin(), partial.end(), 0);
+    }
+    size_t numRows = 0;
+    size_t numColumns = 0;
+    std::vector<uint64_t> counts;
+};
+
+// Table of every column of X (codes) against y, one column per thread at a time. states has the
+// number of states of every column, a column with 0 states is skipped and gets an empty table
+inline std::vector<ArffContingency> arffContingencies(const std::vector<std::vector<float>>& X, const std::vector<size_t>& states,
+    const std::vector<int>& y, size_t classes, size_t threads = 0)
+{
+    if (states.size() != X.size()) {
+        throw std::invalid_argument("states must have the number of states of every column of X");
+    }
+    std::vector<ArffContingency> tables(X.size());
+    arffParallelFor(X.size(), threads, [&](size_t column) {
+        if (states[column] == 0)
+            return;
+        if (X[column].size() != y.size())
+            throw std::invalid_argument("Every column of X must have a value for each label");
+        tables[column] = ArffContingency::of(X[column].data(), states[column], y.data(), classes, y.size());
+        });
+    return tables;
+}
+// Table of each pair of columns of X, one pair per thread at a time
+inline std::vector<ArffContingency> arffContingencies(const std::vector<std::vector<float>>& X, const std::vector<size_t>& states,
+    const std::vector<std::pair<size_t, size_t>>& pairs, size_t threads = 0)
+{
+    std::vector<ArffContingency> tables(pairs.size());
+    arffParallelFor(pairs.size(), threads, [&](size_t i) {
+        auto [first, second] = pairs[i];
+        const auto& a = X.at(first);
+        const auto& b = X.at(second);
+        if (a.size() != b.size())
+            throw std::invalid_argument("The columns must have the same number of values");
+        tables[i] = ArffContingency::of(a.data(), states.at(first), b.data(), states.at(second), a.size());
+        });
+    return tables;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef ARFFDATASET_HPP
+#define ARFFDATASET_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <stdexcept>
+
+//
+// Result of a load: schema, feature columns, labels and the states of the nominal attributes.
+// It can't be changed once built, so one instance can be read from any number of threads at once.
+// ArffFiles::getDataset() and ArffFiles::releaseDataset() hand it out as a shared_ptr<const ArffDataset>
+//
+class ArffDataset {
+public:
+    ArffDataset() = default;
+    ArffDataset(std::vector<std::pair<std::string, std::string>> attributes, std::map<std::string, bool> numeric_features, std::string className,
+        std::string classType, std::vector<std::vector<float>> X, std::vector<int> y, std::map<std::string, std::vector<std::string>> states,
+        std::map<std::string, std::vector<std::string>> dictionaries = {}, std::vector<std::string> targets = {}, std::vector<int> Y = {})
+        : attributes(std::move(attributes)), numeric_features(std::move(numeric_features)), className(std::move(className)),
+        classType(std::move(classType)), X(std::move(X)), y(std::move(y)), states(std::move(states)), dictionaries(std::move(dictionaries)),
+        targets(std::move(targets)), Y(std::move(Y))
+    {
+        if (this->X.size() != this->attributes.size()) {
+            throw std::invalid_argument("X must have a column for each attribute");
+        }
+        for (const auto& column : this->X) {
+            if (column.size() != this->y.size()) {
+                throw std::invalid_argument("Every column of X must have a value for each label");
+            }
+        }
+        if (this->Y.size() != this->y.size() * this->targets.size()) {
+            throw std::invalid_argument("Y must have a value of each target for each label");
+        }
+    }
+    size_t getSize() const { return y.size(); }
+    const std::string& getClassName() const { return className; }
+    const std::string& getClassType() const { return classType; }
+    const std::vector<std::pair<std::string, std::string>>& getAttributes() const { return attributes; }
+    const std::map<std::string, bool>& getNumericAttributes() const { return numeric_features; }
+    const std::map<std::string, std::vector<std::string>>& getStates() const { return states; }
+    const std::vector<std::string>& getLabels() const { return states.at(className); }
+    // Nominal values as found in the file, states add "Class " to the ones made only of digits.
+    // The states when it was built without them
+    const std::map<std::string, std::vector<std::string>>& getDictionaries() const { return dictionaries.empty() ? states : dictionaries; }
+    // Feature major, X[feature][sample]
+    const std::vector<std::vector<float>>& getX() const { return X; }
+    const std::vector<int>& getY() const { return y; }
+    // Of a load with a list of targets, see ArffFiles::getTargets() and ArffFiles::getYMatrix()
+    const std::vector<std::string>& getTargets() const { return targets; }
+    const std::vector<int>& getYMatrix() const { return Y; }
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = (y.capacity() + Y.capacity()) * sizeof(int);
+        for (const auto& column : X) {
+            bytes += column.capacity() * sizeof(float);
+        }
+        return bytes;
+    }
+private:
+    std::vector<std::pair<std::string, std::string>> attributes;
+    std::map<std::string, bool> numeric_features;
+    std::string className;
+    std::string classType;
+    std::vector<std::vector<float>> X;
+    std::vector<int> y;
+    std::map<std::string, std::vector<std::string>> states;
+    std::map<std::string, std::vector<std::string>> dictionaries;
+    std::vector<std::string> targets;
+    std::vector<int> Y;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef ARFFDISCRETIZE_HPP
+#define ARFFDISCRETIZE_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "ArffParallel.hpp"
+
+// EqualWidth splits [min, max] in bins of the same width, EqualFrequency in bins of about the same
+// number of samples and MDLP finds the cut points with the Fayyad-Irani entropy criterion on the labels
+enum class ArffDiscretization { EqualWidth, EqualFrequency, MDLP };
+
+//
+// Learns cut points for feature major columns and maps values to bins: a value goes to the bin of
+// the first cut point greater than it, so bin i holds [cut(i-1), cut(i)). Features are processed in
+// parallel, one thread per feature at a time
+//
+class ArffDiscretizer {
+public:
+    explicit ArffDiscretizer(ArffDiscretization method, size_t bins = 3) : method(method), bins(bins)
+    {
+        if (bins == 0 && method != ArffDiscretization::MDLP) {
+            throw std::invalid_argument("The number of bins must be greater than 0");
+        }
+    }
+    // 0 uses the hardware threads
+    ArffDiscretizer& setThreads(size_t threads)
+    {
+        numThreads = threads;
+        return *this;
+    }
+    // Known min and max of each feature, saves equal width a pass over the data
+    ArffDiscretizer& setRanges(std::vector<std::pair<float, float>> minMax)
+    {
+        ranges = std::move(minMax);
+        return *this;
+    }
+    // Only features with selected[i] set get cut points when selected isn't empty. y is needed by MDLP,
+    // with the labels in [0, classes)
+    ArffDiscretizer& fit(const std::vector<std::vector<float>>& X, const std::vector<int>& y, const std::vector<bool>& selected = {})
+    {
+        if (method == ArffDiscretization::MDLP) {
+            for (const auto& column : X) {
+                if (column.size() != y.size())
+                    throw std::invalid_argument("Every column of X must have a value for each label");
+            }
+        }
+        int classes = y.empty() ? 0 : *std::max_element(y.begin(), y.end()) + 1;
+        cuts.assign(X.size(), std::vector<float>());
+        fittedFeatures.assign(X.size(), false);
+        for (size_t feature = 0; feature < X.size(); feature++) {
+            fittedFeatures[feature] = selected.empty() || selected.at(feature);
+        }
+        arffParallelFor(X.size(), numThreads, [&](size_t feature) {
+            if (!fittedFeatures[feature])
+                return;
+            const auto& column = X[feature];
+            switch (method) {
+                case ArffDiscretization::EqualWidth:
+                    cuts[feature] = equalWidth(column, feature);
+                    break;
+                case ArffDiscretization::EqualFrequency:
+                    cuts[feature] = equalFrequency(column);
+                    break;
+                case ArffDiscretization::MDLP:
+                    cuts[feature] = mdlp(column, y, classes);
+                    break;
+            }
+            });
+        return *this;
+    }
+    // Bin of every value of the features fitted, the others are left as they are and so are missing values
+    std::vector<std::vector<float>> transform(const std::vector<std::vector<float>>& X) const
+    {
+        auto result = X;
+        transformInPlace(result);
+        return result;
+    }
+    void transformInPlace(std::vector<std::vector<float>>& X) const
+    {
+        if (X.size() != cuts.size()) {
+            throw std::invalid_argument("X must have the features fitted");
+        }
+        arffParallelFor(X.size(), numThreads, [&](size_t feature) {
+            if (!fitted(feature))
+                return;
+            const auto& points = cuts[feature];
+            for (auto& value : X[feature]) {
+                if (!std::isnan(value))
+                    value = static_cast<float>(std::upper_bound(points.begin(), points.end(), value) - points.begin());
+            }
+            });
+    }
+    bool fitted(size_t feature) const { return fittedFeatures.at(feature); }
+    const std::vector<std::vector<float>>& getCutPoints() const { return cuts; }
+    // (-inf;c1), [c1;c2), ..., [ck;inf)
+    static std::vector<std::string> intervals(const std::vector<float>& points)
+    {
+        std::vector<std::string> result;
+        std::string lower = "(-inf";
+        for (auto point : points) {
+            auto text = format(point);
+            result.push_back(lower + ";" + text + ")");
+            lower = "[" + text;
+        }
+        result.push_back(lower + ";inf)");
+        return result;
+    }
+private:
+    std::vector<float> equalWidth(const std::vector<float>& column, size_t feature) const
+    {
+        std::vector<float> points;
+        float low = std::numeric_limits<float>::infinity();
+        float high = -low;
+        if (feature < ranges.size()) {
+            low = ranges[feature].first;
+            high = ranges[feature].second;
+        } else {
+            for (auto value : column) {
+                if (std::isnan(value))
+                    continue;
+                low = std::min(low, value);
+                high = std::max(high, value);
+            }
+        }
+        if (!(low < high))
+            return points;
+        double width = (static_cast<double>(high) - low) / static_cast<double>(bins);
+        for (size_t i = 1; i < bins; i++) {
+            points.push_back(static_cast<float>(low + width * static_cast<double>(i)));
+        }
+        return points;
+    }
+    // Each cut is the first value of its bin, found with nth_element over what's left on its right
+    std::vector<float> equalFrequency(const std::vector<float>& column) const
+    {
+        std::vector<float> values;
+        values.reserve(column.size());
+        float minimum = std::numeric_limits<float>::infinity();
+        for (auto value : column) {
+            if (std::isnan(value))
+                continue;
+            values.push_back(value);
+            minimum = std::min(minimum, value);
+        }
+        std::vector<float> points;
+        size_t start = 0;
+        for (size_t i = 1; i < bins && !values.empty(); i++) {
+            size_t position = std::max(start, values.size() * i / bins);
+            if (position >= values.size())
+                break;
+            std::nth_element(values.begin() + start, values.begin() + position, values.end());
+            // Ties with the minimum would leave the first bin empty
+            if (values[position] > minimum && (points.empty() || values[position] > points.back()))
+                points.push_back(values[position]);
+            start = position + 1;
+        }
+        return points;
+    }
+    static double entropy(const std::vector<size_t>& counts, size_t total, int& distinct)
+    {
+        double result = 0;
+        distinct = 0;
+        for (auto count : counts) {
+            if (count == 0)
+                continue;
+            distinct++;
+            double p = static_cast<double>(count) / static_cast<double>(total);
+            result -= p * std::log2(p);
+        }
+        return result;
+    }
+    std::vector<float> mdlp(const std::vector<float>& column, const std::vector<int>& y, int classes) const
+    {
+        std::vector<size_t> order;
+        order.reserve(column.size());
+        for (size_t i = 0; i < column.size(); i++) {
+            if (!std::isnan(column[i]))
+                order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [&column](size_t a, size_t b) { return column[a] < column[b]; });
+        std::vector<float> values(order.size());
+        std::vector<int> labels(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            values[i] = column[order[i]];
+            labels[i] = y[order[i]];
+        }
+        std::vector<float> points;
+        split(values, labels, 0, values.size(), classes, points);
+        return points;
+    }
+    // Best binary split of [begin, end) by class entropy, kept when it passes the MDL criterion
+    static void split(const std::vector<float>& values, const std::vector<int>& labels, size_t begin, size_t end, int classes, std::vector<float>& points)
+    {
+        const size_t n = end - begin;
+        if (n < 2)
+            return;
+        std::vector<size_t> total(classes, 0);
+        for (size_t i = begin; i < end; i++)
+            total[labels[i]]++;
+        int k;
+        const double entropyAll = entropy(total, n, k);
+        if (k < 2)
+            return;
+        std::vector<size_t> left(classes, 0);
+        std::vector<size_t> right(classes);
+        double best = std::numeric_limits<double>::infinity();
+        size_t cut = end;
+        int k1 = 0, k2 = 0;
+        double entropyLeft = 0, entropyRight = 0;
+        for (size_t i = begin; i + 1 < end; i++) {
+            left[labels[i]]++;
+            if (values[i] == values[i + 1])
+                continue;
+            size_t nLeft = i - begin + 1;
+            for (int c = 0; c < classes; c++)
+                right[c] = total[c] - left[c];
+            int kl, kr;
+            double el = entropy(left, nLeft, kl);
+            double er = entropy(right, n - nLeft, kr);
+            double weighted = (static_cast<double>(nLeft) * el + static_cast<double>(n - nLeft) * er) / static_cast<double>(n);
+            if (weighted < best) {
+                best = weighted;
+                cut = i;
+                k1 = kl;
+                k2 = kr;
+                entropyLeft = el;
+                entropyRight = er;
+            }
+        }
+        if (cut == end)
+            return;
+        double gain = entropyAll - best;
+        double delta = std::log2(std::pow(3.0, k) - 2) - (k * entropyAll - k1 * entropyLeft - k2 * entropyRight);
+        if (gain <= (std::log2(static_cast<double>(n - 1)) + delta) / static_cast<double>(n))
+            return;
+        split(values, labels, begin, cut + 1, classes, points);
+        points.push_back((values[cut] + values[cut + 1]) / 2);
+        split(values, labels, cut + 1, end, classes, points);
+    }
+    static std::string format(float value)
+    {
+        char text[64];
+#if defined(__cpp_lib_to_chars)
+        return std::string(text, std::to_chars(text, text + sizeof(text), value).ptr);
+#else
+        return std::string(text, std::snprintf(text, sizeof(text), "%.9g", value));
+#endif
+    }
+    ArffDiscretization method;
+    size_t bins;
+    size_t numThreads = 0;
+    std::vector<std::pair<float, float>> ranges;
+    std::vector<std::vector<float>> cuts;
+    std::vector<bool> fittedFeatures;
+};
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef ARFFEXPORT_HPP
+#define ARFFEXPORT_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <fstream>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include "ArffDataset.hpp"
+#ifdef ARFFFILES_USE_ZLIB
+#include <zlib.h>
+#endif
+
+// Shape X is written with: FeatureMajor is (features, samples) like getX(), SampleMajor is (samples, features)
+enum class ArffLayout { FeatureMajor, SampleMajor };
+
+//
+// Writes X and y for other tools: NumPy .npy and .npz (stored, not deflated) and CSV, with the
+// schema and nominal values in a JSON sidecar. The columns of X are written straight from their
+// buffers, for .npy the sample major layout is the same bytes declared in Fortran order
+//
+class ArffExporter {
+public:
+    ArffExporter(const std::vector<std::pair<std::string, std::string>>& attributes, const std::map<std::string, bool>& numeric_features,
+        const std::string& className, const std::vector<std::vector<float>>& X, const std::vector<int>& y,
+        const std::map<std::string, std::vector<std::string>>& dictionaries)
+        : attributes(attributes), numeric_features(numeric_features), className(className), X(X), y(y), dictionaries(dictionaries)
+    {
+        if (X.size() != attributes.size()) {
+            throw std::invalid_argument("X must have a column for each attribute");
+        }
+        for (const auto& column : X) {
+            if (column.size() != y.size()) {
+                throw std::invalid_argument("Every column of X must have a value for each label");
+            }
+        }
+    }
+    explicit ArffExporter(const ArffDataset& dataset)
+        : ArffExporter(dataset.getAttributes(), dataset.getNumericAttributes(), dataset.getClassName(), dataset.getX(), dataset.getY(),
+            dataset.getDictionaries())
+    {
+    }
+    ArffExporter& setLayout(ArffLayout value)
+    {
+        layout = value;
+        return *this;
+    }
+    // X as float32 and y as int32, nominal attributes as their codes
+    void saveNpy(const std::string& xFileName, const std::string& yFileName) const
+    {
+        auto xFile = create(xFileName);
+        writeX(xFile);
+        finish(xFile);
+        auto yFile = create(yFileName);
+        writeY(yFile);
+        finish(yFile);
+    }
+    // Arrays X and y, np.load(fileName)["X"]
+    void saveNpz(const std::string& fileName) const
+    {
+        auto file = create(fileName);
+        ZipWriter zip(file);
+        zip.begin("X.npy");
+        writeX(zip);
+        zip.end();
+        zip.begin("y.npy");
+        writeY(zip);
+        zip.end();
+        zip.close();
+        finish(file);
+    }
+    // A header row with the attribute names and a row per sample, nominal values and class as their text
+    void saveCsv(const std::string& fileName) const
+    {
+        auto file = create(fileName);
+        std::string text;
+        for (const auto& attribute : attributes) {
+            text += csvQuote(attribute.first) + ",";
+        }
+        text += csvQuote(className) + "\n";
+        std::vector<std::vector<std::string>> values(attributes.size());
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (!numeric_features.at(attributes[i].first)) {
+                for (const auto& value : dictionaries.at(attributes[i].first)) {
+                    values[i].push_back(csvQuote(value));
+                }
+            }
+        }
+        std::vector<std::string> labels;
+        for (const auto& label : dictionaries.at(className)) {
+            labels.push_back(csvQuote(label));
+        }
+        const size_t flushSize = 1 << 20;
+        char number[64];
+        for (size_t row = 0; row < y.size(); row++) {
+            for (size_t i = 0; i < X.size(); i++) {
+                float value = X[i][row];
+                if (!values[i].empty()) {
+                    text += values[i].at(static_cast<size_t>(value));
+                } else if (!std::isnan(value)) {
+                    text.append(number, formatFloat(number, number + sizeof(number), value));
+                }
+                text += ',';
+            }
+            text += labels.at(y[row]);
+            text += '\n';
+            if (text.size() >= flushSize) {
+                file.write(text.data(), text.size());
+                text.clear();
+            }
+        }
+        file.write(text.data(), text.size());
+        finish(file);
+    }
+    // Class, attributes with their type and the values of the nominal ones in code order
+    void saveSchema(const std::string& fileName) const
+    {
+        auto file = create(fileName);
+        std::string json = "{\n  \"samples\": " + std::to_string(y.size()) + ",\n  \"layout\": \"";
+        json += layout == ArffLayout::FeatureMajor ? "feature_major" : "sample_major";
+        json += "\",\n  \"class\": {\"name\": " + jsonQuote(className) + ", \"values\": " + jsonList(dictionaries.at(className)) + "},\n";
+        json += "  \"attributes\": [";
+        for (size_t i = 0; i < attributes.size(); i++) {
+            const auto& [name, type] = attributes[i];
+            json += i > 0 ? ",\n    " : "\n    ";
+            json += "{\"name\": " + jsonQuote(name) + ", ";
+            if (numeric_features.at(name)) {
+                json += "\"type\": \"numeric\"}";
+            } else {
+                json += "\"type\": \"nominal\", \"values\": " + jsonList(dictionaries.at(name)) + "}";
+            }
+        }
+        json += "\n  ]\n}\n";
+        file.write(json.data(), json.size());
+        finish(file);
+    }
+private:
+    // Stored entries with the sizes and CRC in a data descriptor after the data, so it's written in one pass
+    class ZipWriter {
+    public:
+        explicit ZipWriter(std::ostream& output) : output(output) {}
+        void begin(const std::string& name)
+        {
+            current = Entry{ name, offset, 0, 0 };
+            put32(0x04034b50);
+            put16(20);
+            put16(0x0008); // data descriptor follows
+            put16(0); // stored
+            put32(0); // time and date
+            put32(0); // crc
+            put32(0); // sizes
+            put32(0);
+            put16(static_cast<uint16_t>(name.size()));
+            put16(0);
+            raw(name.data(), name.size());
+        }
+        // Data of the current entry
+        void write(const char* data, size_t size)
+        {
+            raw(data, size);
+            current.crc = crc32(current.crc, data, size);
+            current.size += size;
+        }
+        void end()
+        {
+            if (current.size > 0xffffffffu || offset > 0xffffffffu) {
+                throw std::length_error("npz files over 4GB are not supported");
+            }
+            put32(0x08074b50);
+            put32(current.crc);
+            put32(static_cast<uint32_t>(current.size));
+            put32(static_cast<uint32_t>(current.size));
+            entries.push_back(current);
+        }
+        void close()
+        {
+            size_t start = offset;
+            for (const auto& entry : entries) {
+                put32(0x02014b50);
+                put16(20);
+                put16(20);
+                put16(0x0008);
+                put16(0);
+                put32(0);
+                put32(entry.crc);
+                put32(static_cast<uint32_t>(entry.size));
+                put32(static_cast<uint32_t>(entry.size));
+                put16(static_cast<uint16_t>(entry.name.size()));
+                put16(0); // extra
+                put16(0); // comment
+                put16(0); // disk
+                put16(0); // internal attributes
+                put32(0); // external attributes
+                put32(static_cast<uint32_t>(entry.offset));
+                raw(entry.name.data(), entry.name.size());
+            }
+            if (offset > 0xffffffffu) {
+                throw std::length_error("npz files over 4GB are not supported");
+            }
+            size_t size = offset - start;
+            put32(0x06054b50);
+            put16(0);
+            put16(0);
+            put16(static_cast<uint16_t>(entries.size()));
+            put16(static_cast<uint16_t>(entries.size()));
+            put32(static_cast<uint32_t>(size));
+            put32(static_cast<uint32_t>(start));
+            put16(0);
+        }
+    private:
+        struct Entry {
+            std::string name;
+            size_t offset;
+            size_t size;
+            uint32_t crc;
+        };
+        void raw(const char* data, size_t size)
+        {
+            output.write(data, size);
+            offset += size;
+        }
+        void put16(uint16_t value)
+        {
+            char bytes[2] = { char(value & 0xff), char(value >> 8) };
+            raw(bytes, 2);
+        }
+        void put32(uint32_t value)
+        {
+            char bytes[4] = { char(value & 0xff), char((value >> 8) & 0xff), char((value >> 16) & 0xff), char(value >> 24) };
+            raw(bytes, 4);
+        }
+        static uint32_t crc32(uint32_t crc, const char* data, size_t size)
+        {
+#ifdef ARFFFILES_USE_ZLIB
+            while (size > 0) {
+                auto chunk = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+                crc = static_cast<uint32_t>(::crc32(crc, reinterpret_cast<const Bytef*>(data), chunk));
+                data += chunk;
+                size -= chunk;
+            }
+            return crc;
+#else
+            static const auto table = [] {
+                std::array<uint32_t, 256> values{};
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t value = i;
+                    for (int bit = 0; bit < 8; bit++)
+                        value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                    values[i] = value;
+                }
+                return values;
+                }();
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++)
+                crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+            return ~crc;
+#endif
+        }
+        std::ostream& output;
+        size_t offset = 0;
+        Entry current;
+        std::vector<Entry> entries;
+    };
+    static std::ofstream create(const std::string& fileName)
+    {
+        std::ofstream file(fileName, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::invalid_argument("Unable to create file");
+        }
+        return file;
+    }
+    static void finish(std::ofstream& file)
+    {
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Error writing file");
+        }
+    }
+    static bool littleEndian()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    }
+    // Format 1.0 header padded so the data starts aligned to 64 bytes
+    static std::string npyHeader(const char* type, bool fortranOrder, const std::string& shape)
+    {
+        std::string dict = std::string("{'descr': '") + (littleEndian() ? '<' : '>') + type + "', 'fortran_order': " + (fortranOrder ? "True" : "False")
+            + ", 'shape': " + shape + ", }";
+        size_t length = 10 + dict.size() + 1;
+        dict.append((64 - length % 64) % 64, ' ');
+        dict += '\n';
+        std::string header("\x93NUMPY\x01\x00", 8);
+        header += char(dict.size() & 0xff);
+        header += char(dict.size() >> 8);
+        return header + dict;
+    }
+    template <typename Output>
+    void writeX(Output& output) const
+    {
+        auto samples = std::to_string(y.size());
+        auto features = std::to_string(X.size());
+        bool sampleMajor = layout == ArffLayout::SampleMajor;
+        auto shape = sampleMajor ? "(" + samples + ", " + features + ")" : "(" + features + ", " + samples + ")";
+        auto header = npyHeader("f4", sampleMajor, shape);
+        output.write(header.data(), header.size());
+        for (const auto& column : X) {
+            output.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(float));
+        }
+    }
+    template <typename Output>
+    void writeY(Output& output) const
+    {
+        static_assert(sizeof(int) == 4, "y is written as int32");
+        auto header = npyHeader("i4", false, "(" + std::to_string(y.size()) + ",)");
+        output.write(header.data(), header.size());
+        output.write(reinterpret_cast<const char*>(y.data()), y.size() * sizeof(int));
+    }
+    static char* formatFloat(char* first, char* last, float value)
+    {
+#if defined(__cpp_lib_to_chars)
+        return std::to_chars(first, last, value).ptr;
+#else
+        return first + std::snprintf(first, last - first, "%.9g", value);
+#endif
+    }
+    static std::string csvQuote(const std::string& text)
+    {
+        if (text.find_first_of(",\"\n\r") == std::string::npos)
+            return text;
+        std::string result = "\"";
+        for (char c : text) {
+            if (c == '"')
+                result += '"';
+            result += c;
+        }
+        return result + "\"";
+    }
+    static std::string jsonQuote(const std::string& text)
+    {
+        std::string result = "\"";
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+                result += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            } else {
+                result += static_cast<char>(c);
+            }
+        }
+        return result + "\"";
+    }
+    static std::string jsonList(const std::vector<std::string>& values)
+    {
+        std::string result = "[";
+        for (size_t i = 0; i < values.size(); i++) {
+            result += (i > 0 ? ", " : "") + jsonQuote(values[i]);
+        }
+        return result + "]";
+    }
+    const std::vector<std::pair<std::string, std::string>>& attributes;
+    const std::map<std::string, bool>& numeric_features;
+    const std::string& className;
+    const std::vector<std::vector<float>>& X;
+    const std::vector<int>& y;
+    const std::map<std::string, std::vector<std::string>>& dictionaries;
+    ArffLayout layout = ArffLayout::FeatureMajor;
+};
+
+#endif
@@ -3,59 +3,354 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <sstream>
 #include <fstream>
 #include <cctype> // std::isdigit
 #include <algorithm> // std::all_of std::transform
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <charconv>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include "ArffReader.hpp"
+#include "ArffDataset.hpp"
+#include "ArffWriter.hpp"
+#include "ArffExport.hpp"
+#include "ArffScale.hpp"
+#include "ArffDiscretize.hpp"
+#include "ArffSplit.hpp"
+#include "ArffSketch.hpp"
+#include "ArffContingency.hpp"
+#include "ArffParallel.hpp"
+#include "ArffHash.hpp"
 
 #include <iostream> // TODO remove
 
 class ArffFiles {
     const std::string VERSION = "1.1.0";
 public:
+    // Called every progressInterval lines while reading with the bytes consumed so far,
+    // the total size of the input (0 if unknown) and the number of data rows kept. Compressed
+    // files count the bytes of the file
+    using ProgressCallback = std::function<void(size_t bytesRead, size_t totalBytes, size_t rowsRead)>;
+    // Copies share the same flag, so the caller can keep one and hand another to the loader
+    class CancellationToken {
+    public:
+        CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+        void cancel() { flag->store(true); }
+        void reset() { flag->store(false); }
+        bool isCancelled() const { return flag->load(); }
+    private:
+        std::shared_ptr<std::atomic<bool>> flag;
+    };
+    // Filled by every load when enabled with collectStats(true). Tokenize and conversion times are
+    // added up over all the parser threads, the rest are wall clock times
+    struct LoadStats {
+        double ioSeconds = 0; // reading and splitting lines, includes the header
+        double headerSeconds = 0;
+        double preprocessSeconds = 0;
+        double parseSeconds = 0; // tokenize and conversion of the data section left once reading is done
+        double tokenizeSeconds = 0;
+        double conversionSeconds = 0;
+        double factorizeSeconds = 0;
+        double scaleSeconds = 0; // with setScaling()
+        double totalSeconds = 0;
+        size_t bytesRead = 0;
+        size_t rowsKept = 0;
+        size_t rowsDropped = 0; // rows with missing values
+        size_t rowsBeforeSampling = 0; // with setSampling()
+        size_t rowsDuplicated = 0; // with setDeduplicate(), not in rowsKept
+        size_t peakAllocatedBytes = 0; // by the load arena plus X, y, Y, the weights and the row hashes
+        size_t threads = 0; // parser threads used
+    };
+    // Summary of an attribute or the class over the rows kept, filled while parsing. Missing counts
+    // the rows dropped for a '?' in the column. Numeric attributes get min, max, mean and m2 (sum of
+    // squared deviations from the mean), nominal ones and the class the frequency of each state
+    struct ColumnStats {
+        size_t count = 0;
+        size_t missing = 0;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        double mean = 0;
+        double m2 = 0;
+        std::vector<size_t> frequencies;
+        double variance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0; }
+        static ColumnStats of(const float* values, size_t size)
+        {
+            ColumnStats result;
+            double sum = 0;
+            for (size_t i = 0; i < size; i++) {
+                result.min = std::min(result.min, values[i]);
+                result.max = std::max(result.max, values[i]);
+                sum += values[i];
+            }
+            result.count = size;
+            result.mean = size > 0 ? sum / static_cast<double>(size) : 0;
+            for (size_t i = 0; i < size; i++) {
+                double delta = values[i] - result.mean;
+                result.m2 += delta * delta;
+            }
+            return result;
+        }
+        // Chan et al. for partial results of disjoint rows
+        void merge(const ColumnStats& other)
+        {
+            if (other.count == 0)
+                return;
+            double total = static_cast<double>(count + other.count);
+            double delta = other.mean - mean;
+            mean += delta * static_cast<double>(other.count) / total;
+            m2 += other.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / total;
+            count += other.count;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+        }
+    };
     ArffFiles() = default;
+    // Internal storage of every load comes from a monotonic arena over upstream, released as a whole
+    // by the next load or when the object goes away. X and y are always standard vectors
+    explicit ArffFiles(std::pmr::memory_resource* upstream) : upstream(upstream), storage(std::make_shared<LoadStorage>(upstream, 0)) {}
     void load(const std::string& fileName, bool classLast = true)
     {
-        int labelIndex;
-        loadCommon(fileName);
-        if (classLast) {
-            className = std::get<0>(attributes.back());
-            classType = std::get<1>(attributes.back());
-            attributes.pop_back();
-            labelIndex = static_cast<int>(attributes.size());
-        } else {
-            className = std::get<0>(attributes.front());
-            classType = std::get<1>(attributes.front());
-            attributes.erase(attributes.begin());
-            labelIndex = 0;
-        }
-        preprocessDataset(labelIndex);
-        generateDataset(labelIndex);
+        expectClass(classLast);
+        auto source = openFile(fileName);
+        loadCommon(*source);
+        buildDataset(classLast);
+        follow(fileName, *source);
     }
     void load(const std::string& fileName, const std::string& name)
     {
-        int labelIndex;
-        loadCommon(fileName);
-        bool found = false;
-        for (int i = 0; i < attributes.size(); ++i) {
-            if (attributes[i].first == name) {
-                className = std::get<0>(attributes[i]);
-                classType = std::get<1>(attributes[i]);
-                attributes.erase(attributes.begin() + i);
-                labelIndex = i;
-                found = true;
+        expectClass(name);
+        auto source = openFile(fileName);
+        loadCommon(*source);
+        buildDataset(name);
+        follow(fileName, *source);
+    }
+    // Several targets in one parse: all of them are taken out of the attributes and factorized with
+    // their own states into getYMatrix(). The first one is also the class of y and the rest of the API
+    void load(const std::string& fileName, const std::vector<std::string>& targets)
+    {
+        expectClass(targets);
+        auto source = openFile(fileName);
+        loadCommon(*source);
+        buildDataset(targets);
+        follow(fileName, *source);
+    }
+    // Parses the rows appended to the file since the last load or refresh, adding them to X, y and the
+    // states of the nominal attributes. Only complete lines are taken, a line still being written is
+    // left for the next call, but for the last row of the load, which stays until a longer or complete
+    // version of it is read. Needs an uncompressed file loaded with load(). Returns the rows added
+    size_t refresh()
+    {
+        if (followFile.empty()) {
+            throw std::logic_error("refresh needs an uncompressed file loaded with load()");
+        }
+        if (transformed) {
+            throw std::logic_error("refresh can't add rows to scaled or discretized data");
+        }
+        if (sampled) {
+            throw std::logic_error("refresh can't add rows to a sample");
+        }
+        ArffFileSource source(followFile, followOffset);
+        stats = LoadStats();
+        loadStart = now();
+        ownStorage();
+        auto& lines = storage->lines;
+        size_t rowsBefore = lines.size();
+        // The row parsed before it was complete is read again first
+        bool partialChanged = false;
+        ArffLineReader reader(source, readBlockSize, readBlocks);
+        std::string_view line;
+        while (reader.next(line)) {
+            if (!reader.complete()) {
+                // Still being written, it only replaces the kept row if it grew. A missing value in it is
+                // counted once it's complete
+                bool grew = followPartialKept && rowsBefore == lines.size() && line.size() > lines.back().size();
+                if (grew && line.find('?') == std::string_view::npos) {
+                    lines.back().assign(line.data(), line.size());
+                    partialChanged = true;
+                }
                 break;
             }
+            if (followPartialKept) {
+                lines.pop_back();
+                rowsBefore--;
+                followPartialKept = false;
+                partialChanged = true;
+            }
+            if (isDataLine(line))
+                lines.emplace_back(line);
         }
-        if (!found) {
-            throw std::invalid_argument("Class name not found");
+        followOffset += reader.consumed();
+        stats.ioSeconds = seconds(loadStart, now());
+        stats.bytesRead = reader.consumed();
+        stats.rowsKept = lines.size() - rowsBefore;
+        // The labels of a partial row may have taken codes, so everything is factorized again. New rows
+        // are compared with the old ones while parsing, so deduplication also starts over
+        bool again = partialChanged || deduplicate;
+        generateDataset(classIndex, again ? 0 : rowsBefore);
+        return lines.size() - rowsBefore;
+    }
+    // The buffer may also hold a compressed file and only has to be valid during the call
+    void loadFromBuffer(std::string_view buffer, bool classLast = true)
+    {
+        expectClass(classLast);
+        loadCommon(buffer);
+        buildDataset(classLast);
+        followFile.clear();
+    }
+    void loadFromBuffer(std::string_view buffer, const std::string& name)
+    {
+        expectClass(name);
+        loadCommon(buffer);
+        buildDataset(name);
+        followFile.clear();
+    }
+    void loadFromBuffer(std::string_view buffer, const std::vector<std::string>& targets)
+    {
+        expectClass(targets);
+        loadCommon(buffer);
+        buildDataset(targets);
+        followFile.clear();
+    }
+    void loadFromStream(std::istream& stream, bool classLast = true)
+    {
+        expectClass(classLast);
+        loadCommon(stream);
+        buildDataset(classLast);
+        followFile.clear();
+    }
+    void loadFromStream(std::istream& stream, const std::string& name)
+    {
+        expectClass(name);
+        loadCommon(stream);
+        buildDataset(name);
+        followFile.clear();
+    }
+    void loadFromStream(std::istream& stream, const std::vector<std::string>& targets)
+    {
+        expectClass(targets);
+        loadCommon(stream);
+        buildDataset(targets);
+        followFile.clear();
+    }
+    // The object must outlive the returned future and must not be accessed until it is ready.
+    // Errors, including cancellation, are rethrown by future::get()
+    std::future<void> loadAsync(const std::string& fileName, bool classLast = true)
+    {
+        return std::async(std::launch::async, [this, fileName, classLast]() { load(fileName, classLast); });
+    }
+    std::future<void> loadAsync(const std::string& fileName, const std::string& name)
+    {
+        return std::async(std::launch::async, [this, fileName, name]() { load(fileName, name); });
+    }
+    std::future<void> loadAsync(const std::string& fileName, const std::vector<std::string>& targets)
+    {
+        return std::async(std::launch::async, [this, fileName, targets]() { load(fileName, targets); });
+    }
+    void setProgressCallback(ProgressCallback callback, size_t interval = 4096)
+    {
+        progress = std::move(callback);
+        progressInterval = interval == 0 ? 1 : interval;
+    }
+    void setCancellationToken(const CancellationToken& token) { cancellation = token; }
+    void collectStats(bool enabled) { statsEnabled = enabled; }
+    const LoadStats& getLoadStats() const { return stats; }
+    // One per attribute, in the order of getAttributes()
+    const std::vector<ColumnStats>& getColumnStats() const { return columnStats; }
+    const ColumnStats& getClassStats() const { return classStats; }
+    // Built while parsing when enabled with setQuantileSketches() or setHistogram()
+    const ArffQuantileSketch& getQuantileSketch(const std::string& attribute) const
+    {
+        auto i = attributeIndex(attribute);
+        if (i >= sketches.size() || !numeric_features.at(attribute))
+            throw std::invalid_argument("No quantile sketch for attribute " + attribute);
+        return sketches[i];
+    }
+    const ArffHistogram& getHistogram(const std::string& attribute) const
+    {
+        auto i = attributeIndex(attribute);
+        if (i >= histograms.size() || histograms[i].empty())
+            throw std::invalid_argument("No histogram for attribute " + attribute);
+        return histograms[i];
+    }
+    // Number of threads used to parse the data section, 0 uses all the hardware threads
+    void setThreads(size_t threads) { numThreads = threads; }
+    // The file is read in a background thread in blocks of blockSize bytes with up to blocks of them in flight.
+    // Lines are split as blocks arrive and handed in chunks to the parser threads, which start with the first
+    // full chunk
+    void setReadAhead(size_t blockSize, size_t blocks)
+    {
+        if (blockSize == 0 || blocks == 0) {
+            throw std::invalid_argument("Block size and number of blocks must be positive");
         }
-        preprocessDataset(labelIndex);
-        generateDataset(labelIndex);
+        readBlockSize = blockSize;
+        readBlocks = blocks;
+    }
+    // Reader used for files, the io_uring backends fall back to pread where io_uring is not available
+    void setIoBackend(ArffIoBackend backend) { ioBackend = backend; }
+    // Scales the numeric attributes at the end of every load, see scale()
+    void setScaling(ArffScaling mode) { loadScaling = mode; }
+    // KLL sketches of every numeric attribute built while parsing, k sets the accuracy (a rank error of
+    // about 1.7 / k) and 0 turns them off
+    void setQuantileSketches(size_t k) { sketchK = k; }
+    // Histogram of a numeric attribute built while parsing, so its range has to be known. 0 bins removes it
+    void setHistogram(const std::string& attribute, size_t bins, float low, float high)
+    {
+        if (bins == 0) {
+            histogramSpecs.erase(attribute);
+            return;
+        }
+        histogramSpecs[attribute] = ArffHistogram(bins, low, high);
+    }
+    // Keeps a random sample of up to rows data rows, chosen while reading so memory follows the sample
+    // and not the file. The same seed gives the same sample. Stratified sampling keeps up to rows rows
+    // of each class while reading, and a part of each with the class proportions at the end
+    void setSampling(ArffSampling mode, size_t rows, uint64_t seed = 0)
+    {
+        if (mode != ArffSampling::None && rows == 0) {
+            throw std::invalid_argument("The sample must have at least one row");
+        }
+        sampling = mode;
+        sampleRows = rows;
+        sampleSeed = seed;
+    }
+    // 64 bit hash of the values of every row, computed while parsing, see getRowHashes()
+    void setRowHashes(bool enabled) { rowHashesEnabled = enabled; }
+    // Drops the rows whose values are all equal to those of an earlier row while parsing, the first one
+    // stays with its weight. The statistics of the load are then computed from the rows kept
+    void setDeduplicate(bool enabled) { deduplicate = enabled; }
+    std::vector<std::string> getLines() const
+    {
+        std::vector<std::string> result;
+        result.reserve(storage->lines.size());
+        for (const auto& line : storage->lines) {
+            result.emplace_back(line.data(), line.size());
+        }
+        return result;
+    }
+    unsigned long int getSize() const { return storage->lines.size(); }
+    // Bytes held by the loaded lines, X and y
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = storage->counter.current() + (y.capacity() + Y.capacity()) * sizeof(int) + weights.capacity() * sizeof(float) + rowHashes.capacity() * sizeof(uint64_t);
+        for (const auto& column : X) {
+            bytes += column.capacity() * sizeof(float);
+        }
+        return bytes;
     }
-    std::vector<std::string> getLines() const { return lines; }
-    unsigned long int getSize() const { return lines.size(); }
     std::string getClassName() const { return className; }
     std::string getClassType() const { return classType; }
     std::map<std::string, std::vector<std::string>> getStates() const { return states; }
@@ -68,9 +363,191 @@ public:
         return s;
     }
     std::vector<std::vector<float>>& getX() { return X; }
+    const std::vector<std::vector<float>>& getX() const { return X; }
     std::vector<int>& getY() { return y; }
+    const std::vector<int>& getY() const { return y; }
+    // Names of the targets of a load with a list of them, the class first, empty after the other loads
+    const std::vector<std::string>& getTargets() const { return targets; }
+    // Codes of every target row after row, Y[row * getTargets().size() + target], with the states of
+    // each target in getStates()
+    const std::vector<int>& getYMatrix() const { return Y; }
+    // Weight of every row, from a trailing {w} on its line and 1 for the rest
+    const std::vector<float>& getWeights() const { return weights; }
+    // Hash of the values of every row, class included and weight left out, with setRowHashes(true).
+    // Equal rows have equal hashes whatever the formatting of their numbers
+    const std::vector<uint64_t>& getRowHashes() const { return rowHashes; }
+    // n / (classes * rows of the class) for every row, so each class weighs the same in total.
+    // Classes without rows are left out of the count
+    std::vector<float> getClassBalancedWeights() const
+    {
+        const auto& frequencies = classStats.frequencies;
+        size_t present = static_cast<size_t>(std::count_if(frequencies.begin(), frequencies.end(), [](size_t count) { return count > 0; }));
+        std::vector<float> perClass(frequencies.size(), 0);
+        for (size_t label = 0; label < frequencies.size(); label++) {
+            if (frequencies[label] > 0)
+                perClass[label] = static_cast<float>(static_cast<double>(y.size()) / (static_cast<double>(present) * static_cast<double>(frequencies[label])));
+        }
+        std::vector<float> result(y.size());
+        std::transform(y.begin(), y.end(), result.begin(), [&perClass](int label) { return perClass[label]; });
+        return result;
+    }
     std::map<std::string, bool> getNumericAttributes() const { return numeric_features; }
     std::vector<std::pair<std::string, std::string>> getAttributes() const { return attributes; };
+    // Writes the loaded data as ARFF with the class last, see ArffWriter
+    void save(const std::string& fileName, bool sparse = false) const
+    {
+        ArffWriter(attributes, numeric_features, className, X, y, dictionaries).setSparse(sparse).setWeights(weights).setThreads(numThreads).save(fileName);
+    }
+    // Writes X and y as .npy, .npz or CSV from the loaded data, valid until the next load
+    ArffExporter exporter() const { return ArffExporter(attributes, numeric_features, className, X, y, dictionaries); }
+    // Scales the numeric attributes of X in place with the statistics of the load, which are updated
+    // to match. Constant columns become 0. Returns the multiplier and offset applied to each attribute,
+    // (1, 0) for the nominal ones, to transform other data the same way
+    std::vector<std::pair<float, float>> scale(ArffScaling mode)
+    {
+        std::vector<std::pair<float, float>> transform(attributes.size(), { 1.0f, 0.0f });
+        if (mode == ArffScaling::None)
+            return transform;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            auto& column = columnStats.at(i);
+            if (!numeric_features[attributes[i].first] || column.count == 0)
+                continue;
+            double multiplier = 0;
+            double offset = 0;
+            if (mode == ArffScaling::MinMax && column.max > column.min) {
+                multiplier = 1.0 / (static_cast<double>(column.max) - column.min);
+                offset = -column.min * multiplier;
+            }
+            double deviation = std::sqrt(column.m2 / static_cast<double>(column.count));
+            if (mode == ArffScaling::ZScore && deviation > 0) {
+                multiplier = 1.0 / deviation;
+                offset = -column.mean * multiplier;
+            }
+            arffAffine(X[i].data(), X[i].size(), static_cast<float>(multiplier), static_cast<float>(offset));
+            if (i < sketches.size())
+                sketches[i].transform(static_cast<float>(multiplier), static_cast<float>(offset));
+            if (i < histograms.size())
+                histograms[i].transform(static_cast<float>(multiplier), static_cast<float>(offset));
+            column.min = static_cast<float>(column.min * multiplier + offset);
+            column.max = static_cast<float>(column.max * multiplier + offset);
+            column.mean = column.mean * multiplier + offset;
+            column.m2 *= multiplier * multiplier;
+            transform[i] = { static_cast<float>(multiplier), static_cast<float>(offset) };
+        }
+        transformed = true;
+        return transform;
+    }
+    // Turns the numeric attributes into nominal ones whose values are the bins, named after their
+    // intervals. Equal width takes the min and max from the load. Returns the cut points of each
+    // attribute, empty for the nominal ones
+    std::vector<std::vector<float>> discretize(ArffDiscretization method, size_t bins = 3)
+    {
+        std::vector<bool> selected(attributes.size());
+        std::vector<std::pair<float, float>> ranges(attributes.size());
+        for (size_t i = 0; i < attributes.size(); i++) {
+            selected[i] = numeric_features.at(attributes[i].first);
+            ranges[i] = { columnStats.at(i).min, columnStats.at(i).max };
+        }
+        ArffDiscretizer discretizer(method, bins);
+        discretizer.setThreads(numThreads).setRanges(std::move(ranges)).fit(X, y, selected).transformInPlace(X);
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (!selected[i])
+                continue;
+            auto& [name, type] = attributes[i];
+            auto labels = ArffDiscretizer::intervals(discretizer.getCutPoints()[i]);
+            type = "{";
+            for (size_t label = 0; label < labels.size(); label++) {
+                type += (label > 0 ? "," : "") + labels[label];
+            }
+            type += "}";
+            numeric_features[name] = false;
+            if (i < sketches.size())
+                sketches[i] = ArffQuantileSketch(sketchK);
+            if (i < histograms.size())
+                histograms[i] = ArffHistogram();
+            states[name] = labels;
+            dictionaries[name] = std::move(labels);
+            auto& column = columnStats[i];
+            ColumnStats nominal;
+            nominal.count = column.count;
+            nominal.missing = column.missing;
+            column = std::move(nominal);
+            column.frequencies.assign(states[name].size(), 0);
+            for (auto value : X[i]) {
+                if (!std::isnan(value))
+                    column.frequencies[static_cast<size_t>(value)]++;
+            }
+        }
+        transformed = true;
+        return discretizer.getCutPoints();
+    }
+    // Joint counts of the codes of a nominal attribute and the class, or of two nominal attributes
+    ArffContingency contingency(const std::string& attribute) const
+    {
+        auto i = nominalIndex(attribute);
+        return ArffContingency::of(X[i].data(), states.at(attribute).size(), y.data(), states.at(className).size(), y.size());
+    }
+    ArffContingency contingency(const std::string& first, const std::string& second) const
+    {
+        auto i = nominalIndex(first);
+        auto j = nominalIndex(second);
+        return ArffContingency::of(X[i].data(), states.at(first).size(), X[j].data(), states.at(second).size(), y.size());
+    }
+    // Table of every attribute against the class, computed in parallel, empty for the numeric ones
+    // (discretize() them first)
+    std::vector<ArffContingency> contingencies() const
+    {
+        std::vector<size_t> sizes(attributes.size(), 0);
+        for (size_t i = 0; i < attributes.size(); i++) {
+            const auto& name = attributes[i].first;
+            if (!numeric_features.at(name))
+                sizes[i] = states.at(name).size();
+        }
+        return arffContingencies(X, sizes, y, states.at(className).size(), numThreads);
+    }
+    // Mutual information in nats of every attribute with the class, NaN for the numeric ones
+    std::vector<double> mutualInformation() const
+    {
+        auto tables = contingencies();
+        std::vector<double> result(tables.size(), std::numeric_limits<double>::quiet_NaN());
+        for (size_t i = 0; i < tables.size(); i++) {
+            if (!numeric_features.at(attributes[i].first))
+                result[i] = tables[i].mutualInformation();
+        }
+        return result;
+    }
+    // Splits of the rows from y, see ArffSplit.hpp
+    std::vector<ArffSplit> stratifiedKFold(size_t k, uint64_t seed = 0) const { return arffStratifiedKFold(y, k, seed); }
+    ArffSplit trainTestSplit(double testSize = 0.25, uint64_t seed = 0, bool stratified = true) const { return arffTrainTestSplit(y, testSize, seed, stratified); }
+    // Rows of X and y without copying them, valid until the next load
+    ArffView view(std::vector<size_t> rows) const { return ArffView(X, y, std::move(rows)).setThreads(numThreads); }
+    // Copy of the results that can be shared with other threads, it doesn't change on later loads
+    std::shared_ptr<const ArffDataset> getDataset() const
+    {
+        return std::make_shared<const ArffDataset>(attributes, numeric_features, className, classType, X, y, states, dictionaries, targets, Y);
+    }
+    // Moves the results out without copying them, the object is left empty until the next load
+    std::shared_ptr<const ArffDataset> releaseDataset()
+    {
+        auto dataset = std::make_shared<const ArffDataset>(std::move(attributes), std::move(numeric_features), std::move(className),
+            std::move(classType), std::move(X), std::move(y), std::move(states), std::move(dictionaries), std::move(targets), std::move(Y));
+        attributes.clear();
+        numeric_features.clear();
+        className.clear();
+        classType.clear();
+        X.clear();
+        y.clear();
+        targets.clear();
+        targetPositions.clear();
+        Y.clear();
+        weights.clear();
+        rowHashes.clear();
+        states.clear();
+        dictionaries.clear();
+        followFile.clear();
+        storage = std::make_shared<LoadStorage>(upstream, 0);
+        return dataset;
+    }
     std::vector<std::string> split(const std::string& text, char delimiter)
     {
         std::vector<std::string> result;
@@ -83,18 +560,564 @@ public:
     }
     std::string version() const { return VERSION; }
 protected:
-    std::vector<std::string> lines;
+    struct LoadStorage;
     std::map<std::string, bool> numeric_features;
     std::vector<std::pair<std::string, std::string>> attributes;
     std::string className;
     std::string classType;
     std::vector<std::vector<float>> X;
-    std::vector<std::vector<std::string>> Xs;
     std::vector<int> y;
+    // Of a load with a list of targets, and the positions in the lines of all of them but the class
+    std::vector<std::string> targets;
+    std::vector<int> targetPositions;
+    std::vector<int> Y;
+    std::vector<float> weights;
+    std::vector<uint64_t> rowHashes;
     std::map<std::string, std::vector<std::string>> states;
+    // Nominal values as read (without the "Class " prefix of states) in code order
+    std::map<std::string, std::vector<std::string>> dictionaries;
+    int classIndex = 0;
+    // Where refresh() carries on
+    std::string followFile;
+    size_t followOffset = 0;
+    bool followPartialKept = false;
+    ProgressCallback progress;
+    size_t progressInterval = 4096;
+    CancellationToken cancellation;
+    size_t numThreads = 0;
+    size_t readBlockSize = 4 << 20;
+    size_t readBlocks = 4;
+    ArffIoBackend ioBackend = ArffIoBackend::Default;
+    bool statsEnabled = false;
+    LoadStats stats;
+    std::vector<ColumnStats> columnStats;
+    ColumnStats classStats;
+    ArffScaling loadScaling = ArffScaling::None;
+    size_t sketchK = 0;
+    std::map<std::string, ArffHistogram> histogramSpecs;
+    std::vector<ArffQuantileSketch> sketches; // of every attribute when enabled, empty for the nominal ones
+    std::vector<ArffHistogram> histograms; // of every attribute when any is asked for
+    ArffSampling sampling = ArffSampling::None;
+    size_t sampleRows = 0;
+    uint64_t sampleSeed = 0;
+    bool sampled = false; // the rows are a sample of the file
+    bool rowHashesEnabled = false;
+    bool deduplicate = false;
+    // Class of the load in progress, an empty name for the first or last attribute, and the other targets
+    std::string expectedClass;
+    bool expectedClassLast = true;
+    std::vector<std::string> expectedTargets;
+    bool transformed = false;
+    std::vector<size_t> missingByPosition; // of every attribute, class included, in file order
+    std::chrono::steady_clock::time_point loadStart;
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource();
+    std::shared_ptr<LoadStorage> storage = std::make_shared<LoadStorage>(upstream, 0);
 private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point now() const { return statsEnabled ? Clock::now() : Clock::time_point(); }
+    static double seconds(Clock::time_point start, Clock::time_point end) { return std::chrono::duration<double>(end - start).count(); }
+    // Keeps track of the bytes the arena takes from upstream
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+        size_t peak() const { return peakBytes; }
+        size_t current() const { return currentBytes; }
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            void* result = upstream->allocate(bytes, alignment);
+            currentBytes += bytes;
+            peakBytes = std::max(peakBytes, currentBytes);
+            return result;
+        }
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            upstream->deallocate(pointer, bytes, alignment);
+            currentBytes -= bytes;
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+        std::pmr::memory_resource* upstream;
+        size_t currentBytes = 0;
+        size_t peakBytes = 0;
+    };
+protected:
+    // Copies of the object share it, it's never modified once the load is done
+    struct LoadStorage {
+        // The lines of a sample come from the pool, so the rows replaced while reading give their memory back
+        LoadStorage(std::pmr::memory_resource* upstream, size_t sizeHint, bool sample = false)
+            : counter(upstream), arena(std::max<size_t>(sizeHint, 4096), &counter), pool(&counter),
+            lines(sample ? static_cast<std::pmr::memory_resource*>(&pool) : &arena)
+        {
+        }
+        CountingResource counter;
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::unsynchronized_pool_resource pool;
+        // A deque so the lines already parsed stay in place while more are read
+        std::pmr::deque<std::pmr::string> lines;
+        // Nominal values of each attribute, pointing into lines
+        std::pmr::vector<std::pmr::vector<std::string_view>> Xs{ &arena };
+    };
+private:
+    // Where the values of a line go and what is built from them while parsing
+    struct RowLayout {
+        // By position in the line: 0 for the class, k for the k-th of the other targets and -1 for the attributes
+        std::vector<int> targetAt;
+        std::vector<bool> isNumeric; // of every attribute
+        std::vector<ArffHistogram> histograms; // with no counts, of every attribute when any is asked for
+        size_t targets = 0; // besides the class
+        size_t sketchK = 0;
+        bool hashing = false;
+    };
+    // Rows parsed together by one thread, merged in order into X and the rest. The values of the
+    // attributes are kept by column, numeric or nominal, the other one empty
+    struct ParsedChunk {
+        size_t firstRow = 0;
+        std::vector<std::string_view> lines;
+        std::vector<std::vector<float>> numeric;
+        std::vector<std::vector<std::string_view>> nominal;
+        std::vector<std::string_view> labels;
+        std::vector<std::vector<std::string_view>> targets;
+        std::vector<float> weights;
+        std::vector<uint64_t> hashes;
+        std::vector<ColumnStats> stats;
+        std::vector<ArffQuantileSketch> sketches;
+        std::vector<ArffHistogram> histograms;
+        double tokenizeSeconds = 0;
+        double conversionSeconds = 0;
+    };
+    // Rows parsed while reading, with the layout expected when the data started
+    struct ParsedLoad {
+        RowLayout layout;
+        std::deque<ParsedChunk> chunks;
+        size_t rows = 0;
+        size_t threads = 0;
+        double seconds = 0; // parsing once reading was done
+    };
+    static constexpr size_t chunkRows = 8192;
+    static constexpr size_t maxArenaBlock = size_t(256) << 20;
+    // From the last load to the dataset built from it
+    std::shared_ptr<ParsedLoad> parsed;
+    // Bench hook in bench/BenchArffFiles.cc, times the parsing kernels below on their own
+    friend struct ArffFilesBenchmark;
+    // Same tokens as split without allocating, the views point into text
+    static void tokenize(std::string_view text, char delimiter, std::vector<std::string_view>& tokens)
+    {
+        tokens.clear();
+        size_t start = 0;
+        while (start < text.size()) {
+            auto end = text.find(delimiter, start);
+            if (end == std::string_view::npos)
+                end = text.size();
+            tokens.push_back(trimToken(text.substr(start, end - start)));
+            start = end + 1;
+        }
+    }
+    // Token at position, empty if the line is shorter
+    static std::string_view tokenAt(std::string_view text, size_t position, char delimiter = ',')
+    {
+        size_t start = 0;
+        for (size_t i = 0; i < position; i++) {
+            start = text.find(delimiter, start);
+            if (start == std::string_view::npos)
+                return std::string_view();
+            start++;
+        }
+        auto end = text.find(delimiter, start);
+        return trimToken(text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start));
+    }
+    // Values of two rows are the same, NaN included
+    static bool sameValue(float a, float b) { return a == b || (std::isnan(a) && std::isnan(b)); }
+    // Instance weight of Weka's syntax, {w} after the last value
+    static bool isWeight(std::string_view token)
+    {
+        return token.size() >= 2 && token.front() == '{' && token.back() == '}';
+    }
+    static std::string_view trimToken(std::string_view token)
+    {
+        auto first = token.find_first_not_of(" '\n\r\t");
+        if (first == std::string_view::npos)
+            return token.substr(0, 0);
+        return token.substr(first, token.find_last_not_of(" '\n\r\t") - first + 1);
+    }
+    // Same results as std::stof on a token without copying it
+    static float toFloat(std::string_view token)
+    {
+        if (!token.empty() && token[0] == '+')
+            token.remove_prefix(1);
+#if defined(__cpp_lib_to_chars)
+        float value;
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (result.ec == std::errc::invalid_argument) {
+            throw std::invalid_argument("stof");
+        }
+        if (result.ec == std::errc::result_out_of_range) {
+            throw std::out_of_range("stof");
+        }
+        return value;
+#else
+        return std::stof(std::string(token));
+#endif
+    }
+    static bool isNumericType(std::string type)
+    {
+        std::transform(type.begin(), type.end(), type.begin(), ::toupper);
+        return type == "REAL" || type == "INTEGER" || type == "NUMERIC";
+    }
+    // Tokenizes and converts the lines of the chunk with the statistics of their values, on its own so
+    // chunks can be parsed by several threads
+    void parseChunk(ParsedChunk& chunk, const RowLayout& layout) const
+    {
+        ARFF_TRACE_SCOPE("arff.parse");
+        const auto& isNumeric = layout.isNumeric;
+        const auto& targetAt = layout.targetAt;
+        const size_t rows = chunk.lines.size();
+        chunk.numeric.resize(isNumeric.size());
+        chunk.nominal.resize(isNumeric.size());
+        for (size_t column = 0; column < isNumeric.size(); column++) {
+            if (isNumeric[column])
+                chunk.numeric[column].resize(rows);
+            else
+                chunk.nominal[column].resize(rows);
+        }
+        chunk.labels.resize(rows);
+        chunk.targets.assign(layout.targets, std::vector<std::string_view>(rows));
+        chunk.weights.assign(rows, 1.0f);
+        chunk.hashes.assign(layout.hashing ? rows : 0, 0);
+        chunk.stats.assign(isNumeric.size(), ColumnStats());
+        // Empty copies, with their own seeds so the chunks don't flip the same coins
+        chunk.sketches.clear();
+        for (size_t i = 0; i < (layout.sketchK > 0 ? isNumeric.size() : 0); i++)
+            chunk.sketches.emplace_back(layout.sketchK, chunk.firstRow);
+        chunk.histograms = layout.histograms;
+        // Lines are processed in batches to time tokenization and conversion apart cheaply
+        const size_t batchSize = 256;
+        std::vector<std::vector<std::string_view>> batch(batchSize);
+        for (size_t first = 0; first < rows; first += batchSize) {
+            checkCancelled();
+            size_t last = std::min(rows, first + batchSize);
+            auto start = now();
+            {
+                ARFF_TRACE_SCOPE("arff.tokenize");
+                for (size_t i = first; i < last; i++) {
+                    tokenize(chunk.lines[i], ',', batch[i - first]);
+                }
+            }
+            auto tokenized = now();
+            {
+                ARFF_TRACE_SCOPE("arff.convert");
+                for (size_t i = first; i < last; i++) {
+                    auto& tokens = batch[i - first];
+                    if (!tokens.empty() && isWeight(tokens.back())) {
+                        chunk.weights[i] = toFloat(tokens.back().substr(1, tokens.back().size() - 2));
+                        tokens.pop_back();
+                    }
+                    if (tokens.size() > targetAt.size()) {
+                        throw std::invalid_argument("Too many values in line: " + std::string(chunk.lines[i]));
+                    }
+                    int pos = 0;
+                    int xIndex = 0;
+                    uint64_t hash = 0;
+                    for (const auto& token : tokens) {
+                        int target = targetAt[pos++];
+                        if (target >= 0) {
+                            (target == 0 ? chunk.labels : chunk.targets[target - 1])[i] = token;
+                            if (layout.hashing)
+                                hash = arffHashCombine(hash, arffHashBytes(token));
+                        } else {
+                            if (isNumeric[xIndex]) {
+                                float value = toFloat(token);
+                                chunk.numeric[xIndex][i] = value;
+                                if (layout.hashing)
+                                    hash = arffHashCombine(hash, arffHashFloat(value));
+                            } else {
+                                chunk.nominal[xIndex][i] = token;
+                                if (layout.hashing)
+                                    hash = arffHashCombine(hash, arffHashBytes(token));
+                            }
+                            xIndex++;
+                        }
+                    }
+                    if (layout.hashing)
+                        chunk.hashes[i] = hash;
+                }
+            }
+            // Two passes over the batch just written, still in cache, instead of a division per value.
+            // Rows that may turn out to be duplicates wait until they are removed
+            for (size_t column = 0; column < isNumeric.size() && !deduplicate; column++) {
+                if (!isNumeric[column])
+                    continue;
+                const float* values = &chunk.numeric[column][first];
+                chunk.stats[column].merge(ColumnStats::of(values, last - first));
+                if (column < chunk.sketches.size())
+                    chunk.sketches[column].add(values, last - first);
+                if (column < chunk.histograms.size() && !chunk.histograms[column].empty())
+                    chunk.histograms[column].add(values, last - first);
+            }
+            chunk.tokenizeSeconds += seconds(start, tokenized);
+            chunk.conversionSeconds += seconds(tokenized, now());
+        }
+    }
+    // With extend the codes already given are kept and new labels get the next ones
+    template <typename Labels>
+    std::vector<int> factorizeLabels(const std::string& feature, const Labels& labels_t, std::pmr::memory_resource* resource, bool extend = false)
+    {
+        ARFF_TRACE_SCOPE("arff.factorize");
+        std::vector<int> yy;
+        auto& featureStates = states.at(feature);
+        auto& values = dictionaries[feature];
+        if (!extend) {
+            featureStates.clear();
+            values.clear();
+        }
+        yy.reserve(labels_t.size());
+        std::pmr::unordered_map<std::string_view, int> labelMap(resource);
+        int i = 0;
+        for (const auto& value : values) {
+            labelMap.emplace(value, i++);
+        }
+        // values can't grow while labelMap points into them
+        std::vector<std::string_view> added;
+        for (const auto& label_t : labels_t) {
+            std::string_view label(label_t);
+            auto found = labelMap.find(label);
+            if (found == labelMap.end()) {
+                found = labelMap.emplace(label, i++).first;
+                added.push_back(label);
+            }
+            yy.push_back(found->second);
+        }
+        for (const auto& label : added) {
+            values.emplace_back(label);
+            bool allDigits = std::all_of(label.begin(), label.end(), ::isdigit);
+            if (allDigits)
+                featureStates.push_back("Class " + std::string(label));
+            else
+                featureStates.emplace_back(label);
+        }
+        return yy;
+    }
+    // Not a comment, declaration nor row with missing values
+    bool isDataLine(std::string_view line)
+    {
+        if (line.empty() || line[0] == '%' || line == "\r" || line == " " || line[0] == '@') {
+            return false;
+        }
+        if (line.find("?", 0) != std::string::npos) {
+            // ignore lines with missing values
+            stats.rowsDropped++;
+            std::vector<std::string_view> tokens;
+            tokenize(line, ',', tokens);
+            missingByPosition.resize(std::max(missingByPosition.size(), tokens.size()));
+            for (size_t i = 0; i < tokens.size(); i++) {
+                if (tokens[i] == "?")
+                    missingByPosition[i]++;
+            }
+            return false;
+        }
+        return true;
+    }
+    // attributes.size() if there's no such attribute
+    size_t attributeIndex(const std::string& name) const
+    {
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (attributes[i].first == name)
+                return i;
+        }
+        return attributes.size();
+    }
+    size_t nominalIndex(const std::string& name) const
+    {
+        auto i = attributeIndex(name);
+        if (i == attributes.size() || numeric_features.at(name))
+            throw std::invalid_argument("No nominal attribute " + name);
+        return i;
+    }
+    void expectClass(bool classLast)
+    {
+        expectedClass.clear();
+        expectedClassLast = classLast;
+        expectedTargets.clear();
+    }
+    void expectClass(const std::string& name)
+    {
+        expectedClass = name;
+        expectedTargets.clear();
+    }
+    void expectClass(const std::vector<std::string>& names)
+    {
+        if (names.empty()) {
+            throw std::invalid_argument("At least one target is needed");
+        }
+        expectedClass = names.front();
+        expectedTargets.assign(names.begin() + 1, names.end());
+    }
+    // Position of the class among the values of a line, the last one if the name isn't known
+    size_t expectedClassPosition() const
+    {
+        if (expectedClass.empty())
+            return expectedClassLast ? attributes.size() - 1 : 0;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (attributes[i].first == expectedClass)
+                return i;
+        }
+        return attributes.size() - 1;
+    }
+    // Layout the dataset will have, from the attributes and the targets asked for, so the rows can be
+    // parsed while reading. generateDataset checks it against the one it ends up with. False when a
+    // target isn't there, buildDataset tells why
+    bool expectedLayout(RowLayout& layout) const
+    {
+        size_t classPosition = attributes.size() - 1;
+        if (!expectedClass.empty())
+            classPosition = attributeIndex(expectedClass);
+        else if (!expectedClassLast)
+            classPosition = 0;
+        if (classPosition == attributes.size())
+            return false;
+        layout.targetAt.assign(attributes.size(), -1);
+        layout.targetAt[classPosition] = 0;
+        for (size_t k = 0; k < expectedTargets.size(); k++) {
+            auto position = attributeIndex(expectedTargets[k]);
+            if (position == attributes.size() || layout.targetAt[position] >= 0)
+                return false;
+            layout.targetAt[position] = static_cast<int>(k + 1);
+        }
+        for (size_t position = 0; position < attributes.size(); position++) {
+            if (layout.targetAt[position] >= 0)
+                continue;
+            const auto& [name, type] = attributes[position];
+            bool numeric = name != attributes[classPosition].first && isNumericType(type);
+            layout.isNumeric.push_back(numeric);
+            if (histogramSpecs.empty())
+                continue;
+            auto spec = histogramSpecs.find(name);
+            layout.histograms.push_back(spec != histogramSpecs.end() && numeric ? spec->second : ArffHistogram());
+        }
+        layout.targets = expectedTargets.size();
+        layout.sketchK = sketchK;
+        layout.hashing = rowHashesEnabled || deduplicate;
+        return true;
+    }
+    void follow(const std::string& fileName, const ArffSource& source)
+    {
+        bool compressed = dynamic_cast<const ArffPeekSource*>(&source) == nullptr;
+        followFile = compressed ? "" : fileName;
+    }
+    // A copy of the object may share the storage, give this one its own before changing it
+    void ownStorage()
+    {
+        if (storage.use_count() == 1)
+            return;
+        auto copy = std::make_shared<LoadStorage>(upstream, 0);
+        for (const auto& line : storage->lines) {
+            copy->lines.emplace_back(line);
+        }
+        storage = copy;
+    }
+    void buildDataset(bool classLast)
+    {
+        int labelIndex;
+        if (classLast) {
+            className = std::get<0>(attributes.back());
+            classType = std::get<1>(attributes.back());
+            attributes.pop_back();
+            labelIndex = static_cast<int>(attributes.size());
+        } else {
+            className = std::get<0>(attributes.front());
+            classType = std::get<1>(attributes.front());
+            attributes.erase(attributes.begin());
+            labelIndex = 0;
+        }
+        classIndex = labelIndex;
+        auto start = now();
+        preprocessDataset(labelIndex);
+        stats.preprocessSeconds = seconds(start, now());
+        generateDataset(labelIndex);
+        scaleLoaded();
+    }
+    void buildDataset(const std::string& name)
+    {
+        int labelIndex;
+        bool found = false;
+        for (int i = 0; i < attributes.size(); ++i) {
+            if (attributes[i].first == name) {
+                className = std::get<0>(attributes[i]);
+                classType = std::get<1>(attributes[i]);
+                attributes.erase(attributes.begin() + i);
+                labelIndex = i;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            throw std::invalid_argument("Class name not found");
+        }
+        classIndex = labelIndex;
+        auto start = now();
+        preprocessDataset(labelIndex);
+        stats.preprocessSeconds = seconds(start, now());
+        generateDataset(labelIndex);
+        scaleLoaded();
+    }
+    void buildDataset(const std::vector<std::string>& names)
+    {
+        std::vector<int> positions;
+        for (const auto& name : names) {
+            auto i = attributeIndex(name);
+            if (i == attributes.size()) {
+                throw std::invalid_argument("Class name not found");
+            }
+            if (std::find(positions.begin(), positions.end(), static_cast<int>(i)) != positions.end()) {
+                throw std::invalid_argument("Target " + name + " is repeated");
+            }
+            positions.push_back(static_cast<int>(i));
+        }
+        int labelIndex = positions[0];
+        className = attributes[labelIndex].first;
+        classType = attributes[labelIndex].second;
+        targets = names;
+        targetPositions.assign(positions.begin() + 1, positions.end());
+        // From the last one so the positions still hold
+        std::sort(positions.begin(), positions.end());
+        for (auto position = positions.rbegin(); position != positions.rend(); ++position) {
+            attributes.erase(attributes.begin() + *position);
+        }
+        classIndex = labelIndex;
+        auto start = now();
+        preprocessDataset(labelIndex);
+        stats.preprocessSeconds = seconds(start, now());
+        generateDataset(labelIndex);
+        scaleLoaded();
+    }
+    std::unique_ptr<ArffSource> openFile(const std::string& fileName) const
+    {
+        std::unique_ptr<ArffSource> source;
+#ifdef ARFFFILES_POSIX_IO
+        if (ioBackend != ArffIoBackend::Default)
+            source = std::make_unique<ArffUringSource>(fileName, ioBackend == ArffIoBackend::UringDirect);
+#endif
+        if (!source)
+            source = std::make_unique<ArffFileSource>(fileName);
+        return arffDecompress(std::move(source), numThreads);
+    }
+    void scaleLoaded()
+    {
+        if (loadScaling == ArffScaling::None)
+            return;
+        auto start = now();
+        scale(loadScaling);
+        stats.scaleSeconds = seconds(start, now());
+        stats.totalSeconds = seconds(loadStart, now());
+    }
+    void checkCancelled() const
+    {
+        if (cancellation.isCancelled()) {
+            throw std::runtime_error("Load cancelled");
+        }
+    }
     void preprocessDataset(int labelIndex)
     {
+        ARFF_TRACE_SCOPE("arff.preprocess");
         //
         // Learn the numeric features
         //
@@ -103,97 +1126,403 @@ private:
             auto feature = attribute.first;
             if (feature == className)
                 continue;
-            auto values = attribute.second;
-            std::transform(values.begin(), values.end(), values.begin(), ::toupper);
-            numeric_features[feature] = values == "REAL" || values == "INTEGER" || values == "NUMERIC";
+            numeric_features[feature] = isNumericType(attribute.second);
         }
     }
-    std::vector<int> factorize(const std::string feature, const std::vector<std::string>& labels_t)
+    // Rows before firstRow are already in X and y and keep their codes
+    void generateDataset(int labelIndex, size_t firstRow = 0)
     {
-        std::vector<int> yy;
-        states.at(feature).clear();
-        yy.reserve(labels_t.size());
-        std::map<std::string, int> labelMap;
-        int i = 0;
-        for (const std::string& label : labels_t) {
-            if (labelMap.find(label) == labelMap.end()) {
-                labelMap[label] = i++;
-                bool allDigits = std::all_of(label.begin(), label.end(), ::isdigit);
-                if (allDigits)
-                    states[feature].push_back("Class " + label);
-                else
-                    states[feature].push_back(label);
+        const auto& lines = storage->lines;
+        auto& Xs = storage->Xs;
+        auto* arena = &storage->arena;
+        const size_t rows = lines.size() - firstRow;
+        const bool hashing = rowHashesEnabled || deduplicate;
+        if (firstRow == 0) {
+            X = std::vector<std::vector<float>>(attributes.size(), std::vector<float>(lines.size()));
+            weights.assign(lines.size(), 1.0f);
+            rowHashes.assign(hashing ? lines.size() : 0, 0);
+        } else {
+            for (auto& column : X) {
+                column.resize(lines.size());
             }
-            yy.push_back(labelMap[label]);
+            weights.resize(firstRow);
+            weights.resize(lines.size(), 1.0f);
+            rowHashes.resize(hashing ? lines.size() : 0);
         }
-        return yy;
-    }
-    void generateDataset(int labelIndex)
-    {
-        X = std::vector<std::vector<float>>(attributes.size(), std::vector<float>(lines.size()));
-        Xs = std::vector<std::vector<std::string>>(attributes.size(), std::vector<std::string>(lines.size()));
-        auto yy = std::vector<std::string>(lines.size(), "");
-        for (size_t i = 0; i < lines.size(); i++) {
-            std::stringstream ss(lines[i]);
-            std::string value;
-            int pos = 0;
-            int xIndex = 0;
-            auto tokens = split(lines[i], ',');
-            for (const auto& token : tokens) {
-                if (pos++ == labelIndex) {
-                    yy[i] = token;
+        Xs.clear();
+        std::vector<bool> isNumeric(attributes.size());
+        for (size_t i = 0; i < attributes.size(); i++) {
+            isNumeric[i] = numeric_features[attributes[i].first];
+            Xs.emplace_back(isNumeric[i] ? 0 : rows);
+        }
+        std::pmr::vector<std::string_view> yy(rows, arena);
+        // Target of every position of a line: 0 for the class, k for the k-th of the other targets and
+        // -1 for the attributes
+        std::vector<int> targetAt(attributes.size() + 1 + targetPositions.size(), -1);
+        targetAt[labelIndex] = 0;
+        std::vector<std::pmr::vector<std::string_view>> ys;
+        for (size_t k = 0; k < targetPositions.size(); k++) {
+            targetAt[targetPositions[k]] = static_cast<int>(k + 1);
+            ys.emplace_back(rows, arena);
+        }
+        if (firstRow == 0) {
+            columnStats.assign(attributes.size(), ColumnStats());
+            classStats = ColumnStats();
+            sketches.assign(sketchK > 0 ? attributes.size() : 0, ArffQuantileSketch(sketchK));
+            histograms.assign(histogramSpecs.empty() ? 0 : attributes.size(), ArffHistogram());
+            for (size_t i = 0; i < histograms.size(); i++) {
+                auto spec = histogramSpecs.find(attributes[i].first);
+                if (spec != histogramSpecs.end() && isNumeric[i])
+                    histograms[i] = spec->second;
+            }
+        }
+        // Same bins with no counts, each chunk starts from a copy
+        RowLayout layout;
+        layout.targetAt = targetAt;
+        layout.isNumeric = isNumeric;
+        for (const auto& histogram : histograms)
+            layout.histograms.push_back(histogram.empty() ? ArffHistogram() : ArffHistogram(histogram.bins(), histogram.getLow(), histogram.getHigh()));
+        layout.targets = ys.size();
+        layout.sketchK = sketchK;
+        layout.hashing = hashing;
+        // The rows parsed while reading are taken if they were parsed the way this dataset needs, else
+        // they are parsed now
+        auto parseStart = now();
+        std::deque<ParsedChunk> chunks;
+        if (parsed && firstRow == 0 && parsed->rows == rows && parsed->layout.targetAt == targetAt && parsed->layout.isNumeric == isNumeric) {
+            chunks = std::move(parsed->chunks);
+            stats.threads = parsed->threads;
+            stats.parseSeconds = parsed->seconds;
+        } else {
+            for (size_t first = firstRow; first < lines.size(); first += chunkRows) {
+                auto& chunk = chunks.emplace_back();
+                chunk.firstRow = first;
+                for (size_t i = first; i < std::min(lines.size(), first + chunkRows); i++)
+                    chunk.lines.emplace_back(lines[i]);
+            }
+            stats.threads = std::max<size_t>(1, std::min(arffThreadCount(numThreads), chunks.size()));
+            arffParallelFor(chunks.size(), numThreads, [&](size_t i) { parseChunk(chunks[i], layout); });
+        }
+        parsed.reset();
+        // Chunks in order into X and the rest, a column at a time
+        const size_t mergeThreads = chunks.size() > 1 ? numThreads : 1;
+        arffParallelFor(attributes.size(), mergeThreads, [&](size_t column) {
+            size_t row = 0;
+            for (auto& chunk : chunks) {
+                if (isNumeric[column]) {
+                    std::copy(chunk.numeric[column].begin(), chunk.numeric[column].end(), X[column].begin() + firstRow + row);
+                    std::vector<float>().swap(chunk.numeric[column]);
                 } else {
-                    if (numeric_features[attributes[xIndex].first]) {
-                        X[xIndex][i] = stof(token);
-                    } else {
-                        Xs[xIndex][i] = token;
-                    }
-                    xIndex++;
+                    std::copy(chunk.nominal[column].begin(), chunk.nominal[column].end(), Xs[column].begin() + row);
+                    std::vector<std::string_view>().swap(chunk.nominal[column]);
+                }
+                columnStats[column].merge(chunk.stats[column]);
+                if (column < sketches.size())
+                    sketches[column].merge(chunk.sketches[column]);
+                if (column < histograms.size() && !histograms[column].empty())
+                    histograms[column].merge(chunk.histograms[column]);
+                row += chunk.lines.size();
+            }
+            });
+        size_t row = 0;
+        for (const auto& chunk : chunks) {
+            std::copy(chunk.labels.begin(), chunk.labels.end(), yy.begin() + row);
+            for (size_t k = 0; k < ys.size(); k++)
+                std::copy(chunk.targets[k].begin(), chunk.targets[k].end(), ys[k].begin() + row);
+            std::copy(chunk.weights.begin(), chunk.weights.end(), weights.begin() + firstRow + row);
+            std::copy(chunk.hashes.begin(), chunk.hashes.end(), rowHashes.begin() + firstRow + row);
+            stats.tokenizeSeconds += chunk.tokenizeSeconds;
+            stats.conversionSeconds += chunk.conversionSeconds;
+            row += chunk.lines.size();
+        }
+        // Deduplication always parses from the first row. A line still being written is never dropped,
+        // refresh() takes it out before reading it again
+        std::vector<char> duplicate;
+        if (deduplicate) {
+            size_t partialRow = followPartialKept ? rows - 1 : ArffRowSet::npos;
+            auto sameRow = [&](size_t a, size_t b) {
+                for (size_t column = 0; column < isNumeric.size(); column++) {
+                    if (isNumeric[column] ? !sameValue(X[column][a], X[column][b]) : Xs[column][a] != Xs[column][b])
+                        return false;
                 }
+                for (const auto& labels : ys) {
+                    if (labels[a] != labels[b])
+                        return false;
+                }
+                return yy[a] == yy[b];
+            };
+            ArffRowSet rowSet(rows);
+            duplicate.assign(rows, 0);
+            arffParallelFor(chunks.size(), numThreads, [&](size_t i) {
+                for (size_t row = chunks[i].firstRow; row < chunks[i].firstRow + chunks[i].lines.size(); row++) {
+                    if (row == partialRow)
+                        continue;
+                    auto dropped = rowSet.insert(rowHashes[row], row, sameRow);
+                    if (dropped != ArffRowSet::npos)
+                        duplicate[dropped] = 1;
+                }
+                });
+        }
+        stats.parseSeconds += seconds(parseStart, now());
+        // Moves the rows kept to the front, in order
+        auto compact = [&duplicate](auto& values) {
+            size_t kept = 0;
+            for (size_t i = 0; i < duplicate.size(); i++) {
+                if (duplicate[i])
+                    continue;
+                if (kept != i)
+                    values[kept] = std::move(values[i]);
+                kept++;
+            }
+            values.resize(kept);
+        };
+        if (deduplicate) {
+            arffParallelFor(attributes.size(), numThreads, [&](size_t column) {
+                if (!isNumeric[column]) {
+                    compact(Xs[column]);
+                    return;
+                }
+                compact(X[column]);
+                columnStats[column] = ColumnStats::of(X[column].data(), X[column].size());
+                if (column < sketches.size())
+                    sketches[column].add(X[column].data(), X[column].size());
+                if (column < histograms.size() && !histograms[column].empty())
+                    histograms[column].add(X[column].data(), X[column].size());
+                });
+            compact(yy);
+            for (auto& labels : ys)
+                compact(labels);
+            for (size_t column = 0; column < attributes.size(); column++) {
+                if (!isNumeric[column])
+                    X[column].resize(yy.size());
             }
+            compact(weights);
+            compact(rowHashes);
+            stats.rowsDuplicated = rows - yy.size();
+            stats.rowsKept -= stats.rowsDuplicated;
         }
+        auto factorizeStart = now();
         for (size_t i = 0; i < attributes.size(); i++) {
-            if (!numeric_features[attributes[i].first]) {
-                auto data = factorize(attributes[i].first, Xs[i]);
-                std::transform(data.begin(), data.end(), X[i].begin(), [](int x) { return float(x);});
+            checkCancelled();
+            if (!isNumeric[i]) {
+                auto data = factorizeLabels(attributes[i].first, Xs[i], arena, firstRow > 0);
+                auto& frequencies = columnStats[i].frequencies;
+                frequencies.resize(states[attributes[i].first].size());
+                std::transform(data.begin(), data.end(), X[i].begin() + firstRow, [&frequencies](int x) { frequencies[x]++; return float(x);});
+                columnStats[i].count += data.size();
+            }
+        }
+        auto labels = factorizeLabels(className, yy, arena, firstRow > 0);
+        y.resize(firstRow);
+        y.insert(y.end(), labels.begin(), labels.end());
+        classStats.frequencies.resize(states[className].size());
+        for (auto label : labels) {
+            classStats.frequencies[label]++;
+        }
+        classStats.count += labels.size();
+        if (!targets.empty()) {
+            const size_t width = targets.size();
+            Y.resize(y.size() * width);
+            for (size_t row = firstRow; row < y.size(); row++)
+                Y[row * width] = y[row];
+            for (size_t k = 0; k < ys.size(); k++) {
+                auto codes = factorizeLabels(targets[k + 1], ys[k], arena, firstRow > 0);
+                for (size_t row = 0; row < codes.size(); row++)
+                    Y[(firstRow + row) * width + k + 1] = codes[row];
+            }
+        }
+        // The lines last, the views of the nominal values point into them
+        if (deduplicate)
+            compact(storage->lines);
+        if (!rowHashesEnabled)
+            rowHashes = std::vector<uint64_t>();
+        // Rows dropped for missing values never reach the parser, they were counted while reading
+        for (size_t position = 0, xIndex = 0; position < missingByPosition.size(); position++) {
+            if (static_cast<int>(position) == labelIndex) {
+                classStats.missing = missingByPosition[position];
+            } else if (position < targetAt.size() && targetAt[position] > 0) {
+                continue;
+            } else if (xIndex < columnStats.size()) {
+                columnStats[xIndex++].missing = missingByPosition[position];
             }
         }
-        y = factorize(className, yy);
+        stats.factorizeSeconds = seconds(factorizeStart, now());
+        stats.peakAllocatedBytes = storage->counter.peak() + X.size() * lines.size() * sizeof(float) + (y.size() + Y.size()) * sizeof(int) + weights.size() * sizeof(float)
+            + (hashing ? lines.size() * sizeof(uint64_t) : 0);
+        stats.totalSeconds = seconds(loadStart, now());
     }
-    void loadCommon(std::string fileName)
+    void loadCommon(ArffSource& source)
     {
-        std::ifstream file(fileName);
-        if (!file.is_open()) {
-            throw std::invalid_argument("Unable to open file");
+        ArffLineReader reader(source, readBlockSize, readBlocks);
+        loadCommon(reader, source.size(), &source);
+    }
+    void loadCommon(std::string_view buffer)
+    {
+        if (arffCompressed(buffer)) {
+            loadCommon(*arffDecompress(std::make_unique<ArffBufferSource>(buffer), numThreads));
+            return;
         }
-        std::string line;
+        ArffLineReader reader(buffer);
+        loadCommon(reader, buffer.size());
+    }
+    void loadCommon(std::istream& stream)
+    {
+        loadCommon(*arffDecompress(std::make_unique<ArffStreamSource>(stream), numThreads));
+    }
+    // source, when given, may report progress in bytes of a compressed file
+    void loadCommon(ArffLineReader& reader, size_t totalBytes, const ArffSource* source = nullptr)
+    {
+        ARFF_TRACE_SCOPE("arff.io");
+        stats = LoadStats();
+        loadStart = now();
+        // Drop the previous load before allocating the new one. The arena starts with room for the text
+        // and the bookkeeping of its lines, up to maxArenaBlock, and grows geometrically past that. The
+        // size of compressed input isn't known
+        storage.reset();
+        size_t sizeHint = sampling == ArffSampling::None ? std::min(totalBytes + totalBytes / 4, maxArenaBlock) : 0;
+        storage = std::make_shared<LoadStorage>(upstream, sizeHint, sampling != ArffSampling::None);
+        auto& lines = storage->lines;
+        attributes.clear();
+        states.clear();
+        dictionaries.clear();
+        missingByPosition.clear();
+        targets.clear();
+        targetPositions.clear();
+        Y.clear();
+        transformed = false;
+        sampled = sampling != ArffSampling::None;
+        std::unique_ptr<ArffReservoir> reservoir;
+        if (sampled)
+            reservoir = std::make_unique<ArffReservoir>(sampleRows, sampleSeed);
+        // Group of every class value for stratified sampling
+        std::unordered_map<std::string, size_t> groups;
+        std::string label;
+        size_t classPosition = 0;
+        followPartialKept = false;
+        size_t bytesRead = 0;
+        size_t lineCount = 0;
         std::string keyword;
         std::string attribute;
         std::string type;
         std::string type_w;
-        while (getline(file, line)) {
+        std::string_view line;
+        // Once the data starts the rows are handed in chunks to the parser threads, which start with the
+        // first full chunk. Not with sampling, the rows kept aren't known until the end
+        parsed.reset();
+        std::shared_ptr<ParsedLoad> parsing;
+        ArffPipeline<ParsedChunk*> parsers(numThreads, [&parsing, this](ParsedChunk* chunk) { parseChunk(*chunk, parsing->layout); });
+        // Bytes of the text, never beyond the total when it's known, or of the compressed file
+        auto report = [&](size_t rows, bool done) {
+            if (source != nullptr && source->inputSize() > 0) {
+                size_t size = source->inputSize();
+                progress(done ? size : std::min(source->inputPosition(), size), size, rows);
+            } else if (done) {
+                size_t total = totalBytes == 0 ? bytesRead : totalBytes;
+                progress(total, total, rows);
+            } else {
+                progress(totalBytes == 0 ? bytesRead : std::min(bytesRead, totalBytes), totalBytes, rows);
+            }
+        };
+        while (reader.next(line)) {
+            bytesRead += line.size() + 1;
+            if (++lineCount % progressInterval == 0) {
+                checkCancelled();
+                if (progress)
+                    report(reservoir ? reservoir->seen() : lines.size(), false);
+            }
             if (line.empty() || line[0] == '%' || line == "\r" || line == " ") {
                 continue;
             }
             if (line.find("@attribute") != std::string::npos || line.find("@ATTRIBUTE") != std::string::npos) {
-                std::stringstream ss(line);
+                auto start = now();
+                std::stringstream ss{ std::string(line) };
                 ss >> keyword >> attribute;
                 type = "";
                 while (ss >> type_w)
                     type += type_w + " ";
                 attributes.emplace_back(trim(attribute), trim(type));
+                stats.headerSeconds += seconds(start, now());
                 continue;
             }
-            if (line[0] == '@') {
+            if (!isDataLine(line))
                 continue;
-            }
-            if (line.find("?", 0) != std::string::npos) {
-                // ignore lines with missing values
+            if (!reservoir) {
+                lines.emplace_back(line);
+                followPartialKept = !reader.complete();
+                if (lines.size() == 1) {
+                    parsing = std::make_shared<ParsedLoad>();
+                    if (!expectedLayout(parsing->layout))
+                        parsing.reset();
+                    else
+                        parsing->chunks.emplace_back();
+                }
+                if (!parsing)
+                    continue;
+                auto& chunk = parsing->chunks.back();
+                chunk.lines.emplace_back(lines.back());
+                if (chunk.lines.size() < chunkRows)
+                    continue;
+                // A parser thread failed, its error is thrown below
+                if (!parsers.push(&chunk))
+                    break;
+                parsing->chunks.emplace_back().firstRow = lines.size();
                 continue;
             }
-            lines.push_back(line);
+            size_t group = 0;
+            if (sampling == ArffSampling::Stratified) {
+                if (reservoir->seen() == 0)
+                    classPosition = expectedClassPosition();
+                if (classPosition + 1 == attributes.size()) {
+                    // The usual place, found from the end
+                    auto values = line;
+                    auto last = values.rfind(',');
+                    if (last != std::string_view::npos && isWeight(trimToken(values.substr(last + 1)))) {
+                        values = values.substr(0, last);
+                        last = values.rfind(',');
+                    }
+                    label.assign(trimToken(last == std::string_view::npos ? values : values.substr(last + 1)));
+                } else {
+                    label.assign(tokenAt(line, classPosition));
+                }
+                auto known = groups.find(label);
+                group = known != groups.end() ? known->second : groups.emplace(label, groups.size()).first->second;
+            }
+            auto slot = reservoir->offer(group);
+            if (slot == lines.size())
+                lines.emplace_back(line);
+            else if (slot != ArffReservoir::npos)
+                lines[slot].assign(line.data(), line.size());
+        }
+        if (reservoir) {
+            std::pmr::deque<std::pmr::string> sample(lines.get_allocator());
+            auto kept = reservoir->select();
+            for (auto slot : kept)
+                sample.push_back(std::move(lines[slot]));
+            lines.swap(sample);
+            stats.rowsBeforeSampling = reservoir->seen();
+        }
+        followOffset = reader.consumed();
+        stats.ioSeconds = seconds(loadStart, now());
+        stats.bytesRead = totalBytes == 0 ? bytesRead : std::min(bytesRead, totalBytes);
+        stats.rowsKept = lines.size();
+        if (parsing) {
+            // The rest of the rows, in this thread when there weren't enough for the parser threads
+            auto start = now();
+            auto& last = parsing->chunks.back();
+            if (!parsers.started())
+                parseChunk(last, parsing->layout);
+            else if (!last.lines.empty())
+                parsers.push(&last);
+            parsers.finish();
+            if (last.lines.empty())
+                parsing->chunks.pop_back();
+            parsing->rows = lines.size();
+            parsing->threads = parsers.started() ? parsers.threads() : 1;
+            parsing->seconds = seconds(start, now());
+            parsed = std::move(parsing);
         }
-        file.close();
+        if (progress)
+            report(lines.size(), true);
         for (const auto& attribute : attributes) {
             states[attribute.first] = std::vector<std::string>();
         }
@@ -0,0 +1,133 @@
+#ifndef ARFFHASH_HPP
+#define ARFFHASH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+//
+// 64 bit hashing in the style of wyhash: input read 8 bytes at a time and folded in with a 64x64->128
+// bit multiply. Fast and well mixed, not meant to resist attacks
+//
+inline uint64_t arffHashMix(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t ha = a >> 32, la = a & 0xffffffff, hb = b >> 32, lb = b & 0xffffffff;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t middle = (ll >> 32) + (hl & 0xffffffff) + (lh & 0xffffffff);
+    uint64_t low = (middle << 32) | (ll & 0xffffffff);
+    uint64_t high = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+    return low ^ high;
+#endif
+}
+constexpr uint64_t arffHashPrime0 = 0xa0761d6478bd642full;
+constexpr uint64_t arffHashPrime1 = 0xe7037ed1a0b428dbull;
+inline uint64_t arffHashBytes(std::string_view bytes, uint64_t seed = 0)
+{
+    uint64_t hash = seed ^ arffHashPrime0;
+    size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, 8);
+        hash = arffHashMix(hash ^ word, arffHashPrime1);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    return arffHashMix(hash ^ tail, arffHashPrime1 ^ bytes.size());
+}
+// Next cell of a row, order matters
+inline uint64_t arffHashCombine(uint64_t hash, uint64_t cell)
+{
+    return arffHashMix(hash ^ cell, arffHashPrime0);
+}
+inline uint64_t arffHashFloat(float value)
+{
+    // 0 and -0 hash the same, and so do all the NaNs
+    if (value == 0)
+        value = 0;
+    if (value != value)
+        value = std::numeric_limits<float>::quiet_NaN();
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return arffHashMix(bits ^ arffHashPrime1, arffHashPrime0);
+}
+
+//
+// Rows seen so far by hash, split in shards with a lock each so several threads can insert at once.
+// Each shard is an open addressing table of (hash, row) kept at most half full, so an insertion is a
+// short linear probe without allocating. Of every group of equal rows the one with the lowest number
+// stays, wherever the threads got to
+//
+class ArffRowSet {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    // rows is the number of rows expected, to size the shards up front
+    explicit ArffRowSet(size_t rows = 0, size_t shards = 64) : shards(std::max<size_t>(shards, 1))
+    {
+        size_t slots = 16;
+        while (slots < 2 * rows / this->shards.size() + 1)
+            slots *= 2;
+        for (auto& shard : this->shards)
+            shard.slots.assign(slots, Slot());
+    }
+    // equal(a, b) compares two rows with the same hash. Returns the row left out by the insertion, row
+    // itself or an equal one with a higher number that it replaces, or npos
+    template <typename Equal>
+    size_t insert(uint64_t hash, size_t row, Equal equal)
+    {
+        // The high bits pick the shard and the low ones the slot
+        auto& shard = shards[(hash >> 32) % shards.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (2 * (shard.used + 1) > shard.slots.size())
+            shard.grow();
+        const size_t mask = shard.slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            auto& slot = shard.slots[i];
+            if (slot.row == npos) {
+                slot = Slot{ hash, row };
+                shard.used++;
+                return npos;
+            }
+            if (slot.hash != hash || !equal(slot.row, row))
+                continue;
+            if (slot.row < row)
+                return row;
+            std::swap(slot.row, row);
+            return row;
+        }
+    }
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        size_t row = npos;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Slot> slots;
+        size_t used = 0;
+        void grow()
+        {
+            std::vector<Slot> old(slots.size() * 2);
+            old.swap(slots);
+            const size_t mask = slots.size() - 1;
+            for (const auto& slot : old) {
+                if (slot.row == npos)
+                    continue;
+                size_t i = slot.hash & mask;
+                while (slots[i].row != npos)
+                    i = (i + 1) & mask;
+                slots[i] = slot;
+            }
+        }
+    };
+    std::vector<Shard> shards;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef ARFFPARALLEL_HPP
+#define ARFFPARALLEL_HPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+// Threads to use when asked for threads, 0 being all the hardware threads
+inline size_t arffThreadCount(size_t threads)
+{
+    return threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+}
+
+//
+// body(i) for every i in [0, count) on up to threads threads (0 uses the hardware threads), the calling
+// one included. Items are handed out one at a time, which suits a few expensive ones such as features.
+// The first exception thrown by body is rethrown once every thread is done
+//
+template <typename Body>
+void arffParallelFor(size_t count, size_t threads, Body body)
+{
+    size_t workers = std::max<size_t>(1, std::min(arffThreadCount(threads), count));
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::exception_ptr> errors(workers);
+    auto work = [&](size_t worker) {
+        try {
+            for (size_t item = next++; item < count; item = next++) {
+                body(item);
+            }
+        }
+        catch (...) {
+            errors[worker] = std::current_exception();
+            next = count;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t worker = 1; worker < workers; worker++) {
+        pool.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+//
+// body(item) for the items pushed by a producer while it goes on, on up to threads threads of
+// arffParallelFor (0 uses the hardware threads) started by the first push. Items are taken in the
+// order they were pushed. Once body throws the rest are dropped, push() returns false and finish()
+// rethrows the error
+//
+template <typename Item>
+class ArffPipeline {
+public:
+    template <typename Body>
+    ArffPipeline(size_t threads, Body body) : workers(arffThreadCount(threads)), body(std::move(body)) {}
+    ArffPipeline(const ArffPipeline&) = delete;
+    ArffPipeline& operator=(const ArffPipeline&) = delete;
+    // Left without finish() when the producer fails, the workers stop after the items they hold
+    ~ArffPipeline()
+    {
+        close(true);
+        if (running.valid())
+            running.wait();
+    }
+    bool push(Item item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failed)
+                return false;
+            items.push_back(std::move(item));
+        }
+        changed.notify_one();
+        if (!launched) {
+            launched = true;
+            running = std::async(std::launch::async, [this]() { arffParallelFor(workers, workers, [this](size_t) { consume(); }); });
+        }
+        return true;
+    }
+    // Waits for the items pushed to be done
+    void finish()
+    {
+        close(false);
+        if (running.valid())
+            running.get();
+    }
+    bool started() const { return launched; }
+    size_t threads() const { return workers; }
+private:
+    void close(bool abandon)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            failed = failed || abandon;
+        }
+        changed.notify_all();
+    }
+    void consume()
+    {
+        while (true) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]() { return !items.empty() || closed || failed; });
+                if (failed || items.empty())
+                    return;
+                item = std::move(items.front());
+                items.pop_front();
+            }
+            try {
+                body(item);
+            }
+            catch (...) {
+                close(true);
+                throw;
+            }
+        }
+    }
+    size_t workers;
+    std::function<void(Item&)> body;
+    std::deque<Item> items;
+    bool closed = false;
+    bool failed = false;
+    bool launched = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::future<void> running;
+};
+
+#endif
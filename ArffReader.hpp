@@ -0,0 +1,957 @@
+#ifndef ARFFREADER_HPP
+#define ARFFREADER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "ArffTrace.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#define ARFFFILES_POSIX_IO
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && !defined(ARFFFILES_NO_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ARFFFILES_IO_URING
+#endif
+
+#ifdef ARFFFILES_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ARFFFILES_USE_ZSTD
+#include <zstd.h>
+#include <future>
+#endif
+#ifdef ARFFFILES_USE_LZMA
+#include <lzma.h>
+#endif
+
+enum class ArffIoBackend {
+    Default, // sequential reads with read-ahead hints
+    Uring, // io_uring with several reads in flight, pread if io_uring is not available
+    UringDirect // as Uring, bypassing the page cache with O_DIRECT when the filesystem allows it
+};
+
+//
+// Sources of bytes for the loader
+//
+class ArffSource {
+public:
+    virtual ~ArffSource() = default;
+    // Reads up to size bytes into buffer, returns 0 at the end of the input
+    virtual size_t read(char* buffer, size_t size) = 0;
+    // Total size of the input in bytes, 0 if unknown
+    virtual size_t size() const { return 0; }
+    // Sources that decode another one: bytes taken from it so far and its size (0 if unknown), to
+    // report progress in bytes of the file. Can be called while another thread reads
+    virtual size_t inputPosition() const { return 0; }
+    virtual size_t inputSize() const { return 0; }
+};
+
+class ArffBufferSource : public ArffSource {
+public:
+    explicit ArffBufferSource(std::string_view buffer) : buffer(buffer) {}
+    size_t read(char* output, size_t size) override
+    {
+        size_t n = std::min(size, buffer.size() - position);
+        std::memcpy(output, buffer.data() + position, n);
+        position += n;
+        return n;
+    }
+    size_t size() const override { return buffer.size(); }
+private:
+    std::string_view buffer;
+    size_t position = 0;
+};
+
+class ArffStreamSource : public ArffSource {
+public:
+    explicit ArffStreamSource(std::istream& stream) : stream(stream) {}
+    size_t read(char* buffer, size_t size) override
+    {
+        if (!stream.good())
+            return 0;
+        stream.read(buffer, static_cast<std::streamsize>(size));
+        if (stream.bad()) {
+            throw std::runtime_error("Error reading stream");
+        }
+        return static_cast<size_t>(stream.gcount());
+    }
+private:
+    std::istream& stream;
+};
+
+class ArffFileSource : public ArffSource {
+public:
+    // Reading starts at offset, size() is what is left from there
+    explicit ArffFileSource(const std::string& fileName, size_t offset = 0)
+    {
+#ifdef ARFFFILES_POSIX_IO
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Unable to open file");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+            fileSize = static_cast<size_t>(st.st_size);
+        if (offset > fileSize) {
+            throw std::out_of_range("Offset beyond the end of the file");
+        }
+        if (offset > 0 && ::lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+            throw std::runtime_error("Error seeking file");
+        }
+        this->offset = offset;
+#if defined(POSIX_FADV_SEQUENTIAL)
+        ::posix_fadvise(fd, static_cast<off_t>(offset), 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+        file.open(fileName, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::invalid_argument("Unable to open file");
+        }
+        file.seekg(0, std::ios::end);
+        fileSize = static_cast<size_t>(file.tellg());
+        if (offset > fileSize) {
+            throw std::out_of_range("Offset beyond the end of the file");
+        }
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+#endif
+        fileSize -= offset;
+    }
+    ~ArffFileSource() override
+    {
+#ifdef ARFFFILES_POSIX_IO
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    }
+    ArffFileSource(const ArffFileSource&) = delete;
+    ArffFileSource& operator=(const ArffFileSource&) = delete;
+    size_t read(char* buffer, size_t size) override
+    {
+#ifdef ARFFFILES_POSIX_IO
+#if defined(POSIX_FADV_WILLNEED)
+        // Ask the kernel to start fetching the block after this one while we are busy with it
+        ::posix_fadvise(fd, static_cast<off_t>(offset + size), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#endif
+        size_t total = 0;
+        while (total < size) {
+            auto n = ::read(fd, buffer + total, size - total);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Error reading file");
+            }
+            if (n == 0)
+                break;
+            total += static_cast<size_t>(n);
+        }
+        offset += total;
+        return total;
+#else
+        file.read(buffer, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(file.gcount());
+#endif
+    }
+    size_t size() const override { return fileSize; }
+private:
+    size_t fileSize = 0;
+#ifdef ARFFFILES_POSIX_IO
+    int fd = -1;
+    size_t offset = 0;
+#else
+    std::ifstream file;
+#endif
+};
+
+#ifdef ARFFFILES_POSIX_IO
+//
+// Keeps depth reads of chunkSize bytes in flight with io_uring (raw syscalls, no liburing needed)
+// and hands them out in file order. Falls back to synchronous pread when io_uring can't be set up
+//
+class ArffUringSource : public ArffSource {
+public:
+    ArffUringSource(const std::string& fileName, bool direct = false, size_t chunkSize = 1 << 20, size_t depth = 8)
+        : chunkSize((chunkSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT), depth(depth == 0 ? 1 : depth)
+    {
+#ifdef O_DIRECT
+        if (direct)
+            fd = ::open(fileName.c_str(), O_RDONLY | O_DIRECT);
+#endif
+        if (fd < 0)
+            fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Unable to open file");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+            fileSize = static_cast<size_t>(st.st_size);
+        slots.resize(this->depth);
+        for (auto& slot : slots) {
+            slot.data = static_cast<char*>(std::aligned_alloc(ALIGNMENT, this->chunkSize));
+            if (slot.data == nullptr) {
+                release();
+                throw std::bad_alloc();
+            }
+        }
+#ifdef ARFFFILES_IO_URING
+        setupRing();
+#endif
+        for (size_t i = 0; i < slots.size(); ++i) {
+            submit(i);
+        }
+        flush();
+    }
+    ~ArffUringSource() override { release(); }
+    ArffUringSource(const ArffUringSource&) = delete;
+    ArffUringSource& operator=(const ArffUringSource&) = delete;
+    size_t read(char* buffer, size_t size) override
+    {
+        size_t total = 0;
+        while (total < size) {
+            auto& slot = slots[current];
+            if (slot.state == Slot::Idle)
+                break;
+            wait(slot);
+            size_t n = std::min(size - total, slot.length - slot.consumed);
+            std::memcpy(buffer + total, slot.data + slot.consumed, n);
+            slot.consumed += n;
+            total += n;
+            if (slot.consumed == slot.length) {
+                bool last = slot.length < chunkSize;
+                slot.state = Slot::Idle;
+                if (!last) {
+                    submit(current);
+                    flush();
+                }
+                current = (current + 1) % slots.size();
+                if (last) {
+                    // Nothing else will be read, cancel the reads beyond the end of the file
+                    for (auto& other : slots) {
+                        if (other.state == Slot::Queued)
+                            wait(other);
+                        other.state = Slot::Idle;
+                    }
+                }
+            }
+        }
+        return total;
+    }
+    size_t size() const override { return fileSize; }
+    bool usingUring() const { return ringFd >= 0; }
+private:
+    static constexpr size_t ALIGNMENT = 4096;
+    struct Slot {
+        enum State { Idle, Pending, Queued, Done } state = Idle;
+        char* data = nullptr;
+        size_t offset = 0;
+        size_t length = 0;
+        size_t consumed = 0;
+    };
+    void submit(size_t index)
+    {
+        auto& slot = slots[index];
+        if (nextOffset >= fileSize) {
+            slot.state = Slot::Idle;
+            return;
+        }
+        slot.offset = nextOffset;
+        slot.length = 0;
+        slot.consumed = 0;
+        nextOffset += chunkSize;
+        slot.state = Slot::Pending;
+#ifdef ARFFFILES_IO_URING
+        if (ringFd >= 0) {
+            unsigned tail = sqTail->load(std::memory_order_relaxed);
+            unsigned position = tail & sqMask;
+            auto& sqe = sqes[position];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<unsigned long long>(slot.data);
+            sqe.len = static_cast<unsigned>(chunkSize);
+            sqe.off = slot.offset;
+            sqe.user_data = index;
+            sqArray[position] = position;
+            sqTail->store(tail + 1, std::memory_order_release);
+            slot.state = Slot::Queued;
+            toSubmit++;
+        }
+#endif
+    }
+    void flush()
+    {
+#ifdef ARFFFILES_IO_URING
+        while (toSubmit > 0) {
+            int submitted = enter(toSubmit, 0, 0);
+            if (submitted < 0)
+                throw std::runtime_error("Error submitting reads");
+            toSubmit -= static_cast<unsigned>(submitted);
+        }
+#endif
+    }
+    void wait(Slot& slot)
+    {
+        if (slot.state == Slot::Pending) {
+            slot.length = preadFully(slot.data, chunkSize, slot.offset);
+            slot.state = Slot::Done;
+        }
+#ifdef ARFFFILES_IO_URING
+        while (slot.state == Slot::Queued) {
+            unsigned head = cqHead->load(std::memory_order_relaxed);
+            if (head == cqTail->load(std::memory_order_acquire)) {
+                if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0)
+                    throw std::runtime_error("Error waiting for reads");
+                continue;
+            }
+            const auto& cqe = cqes[head & cqMask];
+            auto& done = slots[cqe.user_data];
+            int result = cqe.res;
+            cqHead->store(head + 1, std::memory_order_release);
+            done.state = Slot::Done;
+            if (result < 0) {
+                if (result == -EAGAIN || result == -EINTR) {
+                    done.length = preadFully(done.data, chunkSize, done.offset);
+                } else {
+                    throw std::runtime_error("Error reading file");
+                }
+            } else {
+                done.length = static_cast<size_t>(result);
+                // Regular files only return short reads at the end, but finish the chunk just in case
+                size_t expected = std::min(chunkSize, fileSize - std::min(fileSize, done.offset));
+                if (done.length < expected)
+                    done.length += preadFully(done.data + done.length, expected - done.length, done.offset + done.length);
+            }
+        }
+#endif
+    }
+    size_t preadFully(char* buffer, size_t size, size_t offset)
+    {
+        size_t total = 0;
+        while (total < size) {
+            auto n = ::pread(fd, buffer + total, size - total, static_cast<off_t>(offset + total));
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Error reading file");
+            }
+            if (n == 0)
+                break;
+            total += static_cast<size_t>(n);
+        }
+        return total;
+    }
+    void release()
+    {
+#ifdef ARFFFILES_IO_URING
+        if (ringFd >= 0) {
+            // Reads still in flight target our buffers, drain them before freeing anything
+            for (auto& slot : slots) {
+                try {
+                    if (slot.state == Slot::Queued)
+                        wait(slot);
+                }
+                catch (...) {
+                }
+            }
+            if (sqes != MAP_FAILED)
+                ::munmap(sqes, sqesSize);
+            if (cqRing != MAP_FAILED && cqRing != sqRing)
+                ::munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED)
+                ::munmap(sqRing, sqRingSize);
+            ::close(ringFd);
+            ringFd = -1;
+        }
+#endif
+        for (auto& slot : slots) {
+            std::free(slot.data);
+            slot.data = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+#ifdef ARFFFILES_IO_URING
+    int enter(unsigned submit, unsigned complete, unsigned flags)
+    {
+        int result;
+        do {
+            result = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, submit, complete, flags, nullptr, 0));
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+    void setupRing()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(slots.size()), &params));
+        if (ringFd < 0)
+            return;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing != MAP_FAILED) {
+            cqRing = single ? sqRing : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        if (cqRing != MAP_FAILED) {
+            sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        }
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            if (cqRing != MAP_FAILED && cqRing != sqRing)
+                ::munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED)
+                ::munmap(sqRing, sqRingSize);
+            sqRing = cqRing = MAP_FAILED;
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+            ::close(ringFd);
+            ringFd = -1;
+            return;
+        }
+        auto* sq = static_cast<char*>(sqRing);
+        auto* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<std::atomic<unsigned>*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<std::atomic<unsigned>*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<std::atomic<unsigned>*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    std::atomic<unsigned>* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    std::atomic<unsigned>* cqHead = nullptr;
+    std::atomic<unsigned>* cqTail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cqMask = 0;
+    unsigned toSubmit = 0;
+#endif
+    int fd = -1;
+    int ringFd = -1;
+    size_t fileSize = 0;
+    size_t chunkSize;
+    size_t depth;
+    size_t nextOffset = 0;
+    size_t current = 0;
+    std::vector<Slot> slots;
+};
+#endif
+
+//
+// Gives back the bytes read to detect the format before continuing with the rest of the input
+//
+class ArffPeekSource : public ArffSource {
+public:
+    ArffPeekSource(std::unique_ptr<ArffSource> input, size_t count) : input(std::move(input))
+    {
+        head.resize(count);
+        size_t n = 0;
+        size_t total = 0;
+        while (total < count && (n = this->input->read(head.data() + total, count - total)) > 0)
+            total += n;
+        head.resize(total);
+    }
+    size_t read(char* buffer, size_t size) override
+    {
+        if (position < head.size()) {
+            size_t n = std::min(size, head.size() - position);
+            std::memcpy(buffer, head.data() + position, n);
+            position += n;
+            return n;
+        }
+        return input->read(buffer, size);
+    }
+    size_t size() const override { return input->size(); }
+    const std::string& peeked() const { return head; }
+private:
+    std::unique_ptr<ArffSource> input;
+    std::string head;
+    size_t position = 0;
+};
+
+#ifdef ARFFFILES_USE_ZLIB
+// gzip (also concatenated members) and zlib streams
+class ArffGzipSource : public ArffSource {
+public:
+    explicit ArffGzipSource(std::unique_ptr<ArffSource> input) : input(std::move(input)), in(1 << 20)
+    {
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+            throw std::runtime_error("Unable to initialize gzip decompression");
+        }
+    }
+    ~ArffGzipSource() override { inflateEnd(&stream); }
+    ArffGzipSource(const ArffGzipSource&) = delete;
+    ArffGzipSource& operator=(const ArffGzipSource&) = delete;
+    size_t read(char* buffer, size_t size) override
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+        while (stream.avail_out > 0 && !finished) {
+            if (stream.avail_in == 0 && !fill()) {
+                throw std::runtime_error("Truncated gzip data");
+            }
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                // Another member may follow
+                if (stream.avail_in == 0 && !fill()) {
+                    finished = true;
+                    break;
+                }
+                inflateReset(&stream);
+            } else if (result != Z_OK && result != Z_BUF_ERROR) {
+                throw std::runtime_error("Corrupt gzip data");
+            }
+        }
+        return size - stream.avail_out;
+    }
+    size_t inputPosition() const override { return inputBytes; }
+    size_t inputSize() const override { return input->size(); }
+private:
+    bool fill()
+    {
+        size_t n = input->read(in.data(), in.size());
+        inputBytes += n;
+        stream.next_in = reinterpret_cast<Bytef*>(in.data());
+        stream.avail_in = static_cast<uInt>(n);
+        return n > 0;
+    }
+    std::unique_ptr<ArffSource> input;
+    std::vector<char> in;
+    z_stream stream;
+    bool finished = false;
+    std::atomic<size_t> inputBytes{ 0 };
+};
+#endif
+
+#ifdef ARFFFILES_USE_LZMA
+class ArffXzSource : public ArffSource {
+public:
+    explicit ArffXzSource(std::unique_ptr<ArffSource> input) : input(std::move(input)), in(1 << 20)
+    {
+        if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            throw std::runtime_error("Unable to initialize xz decompression");
+        }
+    }
+    ~ArffXzSource() override { lzma_end(&stream); }
+    ArffXzSource(const ArffXzSource&) = delete;
+    ArffXzSource& operator=(const ArffXzSource&) = delete;
+    size_t read(char* buffer, size_t size) override
+    {
+        stream.next_out = reinterpret_cast<uint8_t*>(buffer);
+        stream.avail_out = size;
+        while (stream.avail_out > 0 && !finished) {
+            if (stream.avail_in == 0 && !inputDone) {
+                size_t n = input->read(in.data(), in.size());
+                inputBytes += n;
+                stream.next_in = reinterpret_cast<const uint8_t*>(in.data());
+                stream.avail_in = n;
+                inputDone = n == 0;
+            }
+            auto result = lzma_code(&stream, inputDone ? LZMA_FINISH : LZMA_RUN);
+            if (result == LZMA_STREAM_END) {
+                finished = true;
+            } else if (result != LZMA_OK) {
+                throw std::runtime_error("Corrupt xz data");
+            }
+        }
+        return size - stream.avail_out;
+    }
+    size_t inputPosition() const override { return inputBytes; }
+    size_t inputSize() const override { return input->size(); }
+private:
+    std::unique_ptr<ArffSource> input;
+    std::vector<char> in;
+    lzma_stream stream = LZMA_STREAM_INIT;
+    bool inputDone = false;
+    bool finished = false;
+    std::atomic<size_t> inputBytes{ 0 };
+};
+#endif
+
+#ifdef ARFFFILES_USE_ZSTD
+//
+// Files made of several frames with known content size (pzstd, seekable format or simply
+// concatenated files) are decompressed a batch of frames at a time in parallel. Anything else
+// is decompressed as a stream
+//
+class ArffZstdSource : public ArffSource {
+public:
+    explicit ArffZstdSource(std::unique_ptr<ArffSource> input, size_t threads = 0) : input(std::move(input))
+    {
+        this->threads = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+        streaming = this->threads == 1;
+        context = ZSTD_createDStream();
+        if (context == nullptr) {
+            throw std::runtime_error("Unable to initialize zstd decompression");
+        }
+    }
+    ~ArffZstdSource() override { ZSTD_freeDStream(context); }
+    ArffZstdSource(const ArffZstdSource&) = delete;
+    ArffZstdSource& operator=(const ArffZstdSource&) = delete;
+    size_t read(char* buffer, size_t size) override
+    {
+        size_t total = 0;
+        while (total < size) {
+            if (!ready.empty()) {
+                auto& front = ready.front();
+                size_t n = std::min(size - total, front.size() - readyPosition);
+                std::memcpy(buffer + total, front.data() + readyPosition, n);
+                readyPosition += n;
+                total += n;
+                if (readyPosition == front.size()) {
+                    ready.pop_front();
+                    readyPosition = 0;
+                }
+                continue;
+            }
+            if (streaming) {
+                size_t n = decompressStream(buffer + total, size - total);
+                if (n == 0)
+                    break;
+                total += n;
+            } else if (!decompressFrames()) {
+                break;
+            }
+        }
+        return total;
+    }
+    size_t inputPosition() const override { return inputBytes; }
+    size_t inputSize() const override { return input->size(); }
+private:
+    // Frames larger than this (compressed or decompressed) are not worth buffering whole
+    static constexpr size_t MAX_FRAME = size_t(256) << 20;
+    static constexpr size_t CHUNK = size_t(4) << 20;
+    bool fill()
+    {
+        if (inputDone)
+            return false;
+        if (inPosition > 0) {
+            in.erase(in.begin(), in.begin() + inPosition);
+            inPosition = 0;
+        }
+        size_t previous = in.size();
+        in.resize(previous + CHUNK);
+        size_t n = input->read(in.data() + previous, CHUNK);
+        inputBytes += n;
+        in.resize(previous + n);
+        inputDone = n == 0;
+        return n > 0;
+    }
+    // Decompresses the next batch of complete frames in parallel, false at the end of the input
+    bool decompressFrames()
+    {
+        std::vector<std::pair<const char*, size_t>> frames;
+        std::vector<size_t> sizes;
+        size_t position = inPosition;
+        while (frames.size() < threads) {
+            const char* start = in.data() + position;
+            size_t available = in.size() - position;
+            size_t frameSize = available == 0 ? 0 : ZSTD_findFrameCompressedSize(start, available);
+            if (available == 0 || ZSTD_isError(frameSize)) {
+                if (!frames.empty())
+                    break;
+                if (available >= MAX_FRAME || !fill()) {
+                    if (in.size() == inPosition)
+                        return false;
+                    streaming = true;
+                    return true;
+                }
+                position = inPosition;
+                continue;
+            }
+            auto content = ZSTD_getFrameContentSize(start, frameSize);
+            if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR || content > MAX_FRAME) {
+                if (frames.empty()) {
+                    // Leave it to the streaming decoder
+                    streaming = true;
+                    return true;
+                }
+                break;
+            }
+            frames.emplace_back(start, frameSize);
+            sizes.push_back(static_cast<size_t>(content));
+            position += frameSize;
+        }
+        std::vector<std::future<std::vector<char>>> results;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            results.push_back(std::async(std::launch::async, [frame = frames[i], size = sizes[i]]() {
+                std::vector<char> output(size);
+                size_t n = ZSTD_decompress(output.data(), size, frame.first, frame.second);
+                if (ZSTD_isError(n)) {
+                    throw std::runtime_error("Corrupt zstd data");
+                }
+                output.resize(n);
+                return output;
+                }));
+        }
+        for (auto& result : results) {
+            ready.push_back(result.get());
+        }
+        inPosition = position;
+        return true;
+    }
+    size_t decompressStream(char* buffer, size_t size)
+    {
+        ZSTD_outBuffer output = { buffer, size, 0 };
+        while (output.pos == 0) {
+            if (inPosition == in.size() && !fill()) {
+                if (!frameDone) {
+                    throw std::runtime_error("Truncated zstd data");
+                }
+                break;
+            }
+            ZSTD_inBuffer source = { in.data() + inPosition, in.size() - inPosition, 0 };
+            size_t result = ZSTD_decompressStream(context, &output, &source);
+            if (ZSTD_isError(result)) {
+                throw std::runtime_error("Corrupt zstd data");
+            }
+            inPosition += source.pos;
+            frameDone = result == 0;
+        }
+        return output.pos;
+    }
+    std::unique_ptr<ArffSource> input;
+    ZSTD_DStream* context = nullptr;
+    size_t threads;
+    bool streaming;
+    bool inputDone = false;
+    bool frameDone = true;
+    std::vector<char> in;
+    size_t inPosition = 0;
+    std::deque<std::vector<char>> ready;
+    size_t readyPosition = 0;
+    std::atomic<size_t> inputBytes{ 0 };
+};
+#endif
+
+inline bool arffCompressed(std::string_view head)
+{
+    auto startsWith = [&head](const char* prefix, size_t length) { return head.size() >= length && head.compare(0, length, std::string_view(prefix, length)) == 0; };
+    return startsWith("\x1f\x8b", 2) || startsWith("\x28\xb5\x2f\xfd", 4) || startsWith("\xfd" "7zXZ\x00", 6);
+}
+
+// Wraps the input in a decompressor if it starts with the magic bytes of gzip, zstd or xz
+inline std::unique_ptr<ArffSource> arffDecompress(std::unique_ptr<ArffSource> input, size_t threads = 0)
+{
+    auto peek = std::make_unique<ArffPeekSource>(std::move(input), 6);
+    const auto& magic = peek->peeked();
+    auto startsWith = [&magic](const char* prefix, size_t length) { return magic.size() >= length && magic.compare(0, length, prefix, length) == 0; };
+    if (startsWith("\x1f\x8b", 2)) {
+#ifdef ARFFFILES_USE_ZLIB
+        return std::make_unique<ArffGzipSource>(std::move(peek));
+#else
+        throw std::invalid_argument("gzip support not enabled (ARFFFILES_WITH_ZLIB)");
+#endif
+    }
+    if (startsWith("\x28\xb5\x2f\xfd", 4)) {
+#ifdef ARFFFILES_USE_ZSTD
+        return std::make_unique<ArffZstdSource>(std::move(peek), threads);
+#else
+        (void)threads;
+        throw std::invalid_argument("zstd support not enabled (ARFFFILES_WITH_ZSTD)");
+#endif
+    }
+    if (startsWith("\xfd" "7zXZ\x00", 6)) {
+#ifdef ARFFFILES_USE_LZMA
+        return std::make_unique<ArffXzSource>(std::move(peek));
+#else
+        throw std::invalid_argument("xz support not enabled (ARFFFILES_WITH_LZMA)");
+#endif
+    }
+    (void)threads;
+    return peek;
+}
+
+//
+// Reads blocks from a source in a background thread into a ring of buffers,
+// so disk (or network) latency overlaps with the parsing done by the consumer
+//
+class ArffBlockReader {
+public:
+    ArffBlockReader(ArffSource& source, size_t blockSize, size_t count) : source(source)
+    {
+        if (blockSize == 0 || count == 0) {
+            throw std::invalid_argument("Block size and number of blocks must be positive");
+        }
+        buffers.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            buffers[i].data.resize(blockSize);
+            free.push_back(i);
+        }
+        worker = std::thread(&ArffBlockReader::produce, this);
+    }
+    ~ArffBlockReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    ArffBlockReader(const ArffBlockReader&) = delete;
+    ArffBlockReader& operator=(const ArffBlockReader&) = delete;
+    // Returns the next block of data, empty at the end of the input. The view is valid until the next call
+    std::string_view next()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (current != NONE) {
+            free.push_back(current);
+            current = NONE;
+            changed.notify_all();
+        }
+        changed.wait(lock, [this]() { return !filled.empty() || finished; });
+        if (filled.empty()) {
+            if (error)
+                std::rethrow_exception(error);
+            return {};
+        }
+        current = filled.front();
+        filled.pop_front();
+        return { buffers[current].data.data(), buffers[current].length };
+    }
+private:
+    struct Block {
+        std::vector<char> data;
+        size_t length = 0;
+    };
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+    void produce()
+    {
+        try {
+            while (true) {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [this]() { return !free.empty() || stopping; });
+                    if (stopping)
+                        break;
+                    index = free.front();
+                    free.pop_front();
+                }
+                auto& block = buffers[index];
+                {
+                    ARFF_TRACE_SCOPE("arff.read");
+                    block.length = source.read(block.data.data(), block.data.size());
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (block.length == 0) {
+                    free.push_back(index);
+                    break;
+                }
+                filled.push_back(index);
+                changed.notify_all();
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        changed.notify_all();
+    }
+    ArffSource& source;
+    std::vector<Block> buffers;
+    std::deque<size_t> free;
+    std::deque<size_t> filled;
+    size_t current = NONE;
+    bool stopping = false;
+    bool finished = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread worker;
+};
+
+//
+// Splits the blocks into lines with the same semantics as std::getline
+//
+class ArffLineReader {
+public:
+    ArffLineReader(ArffSource& source, size_t blockSize, size_t count) : blocks(std::make_unique<ArffBlockReader>(source, blockSize, count)) {}
+    // Reads the lines straight from a buffer already in memory, no copies nor threads involved
+    explicit ArffLineReader(std::string_view buffer) : block(buffer) {}
+    // Returns false at the end of the input. The view is valid until the next call
+    bool next(std::string_view& line)
+    {
+        while (true) {
+            auto end = block.find('\n', position);
+            if (end != std::string_view::npos) {
+                auto chunk = block.substr(position, end - position);
+                position = end + 1;
+                if (pending.empty()) {
+                    line = chunk;
+                } else {
+                    pending.append(chunk);
+                    line = pendingLine(pending);
+                }
+                completeBytes += line.size() + 1;
+                lastComplete = true;
+                return true;
+            }
+            pending.append(block.substr(position));
+            block = blocks ? blocks->next() : std::string_view();
+            position = 0;
+            if (block.empty()) {
+                if (pending.empty())
+                    return false;
+                line = pendingLine(pending);
+                lastComplete = false;
+                return true;
+            }
+        }
+    }
+    // Bytes of the input up to the newline of the last complete line returned
+    size_t consumed() const { return completeBytes; }
+    // False when the last line returned reached the end of the input without a newline
+    bool complete() const { return lastComplete; }
+private:
+    // Moves the carried over text out of the way so the next line can start accumulating
+    std::string_view pendingLine(std::string& text)
+    {
+        last.swap(text);
+        text.clear();
+        return last;
+    }
+    std::unique_ptr<ArffBlockReader> blocks;
+    std::string_view block;
+    size_t position = 0;
+    std::string pending;
+    std::string last;
+    size_t completeBytes = 0;
+    bool lastComplete = true;
+};
+
+#endif
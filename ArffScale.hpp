@@ -0,0 +1,67 @@
+#ifndef ARFFSCALE_HPP
+#define ARFFSCALE_HPP
+
+#include <cstddef>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ARFFFILES_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// MinMax maps every numeric attribute to [0, 1], ZScore to mean 0 and (population) standard deviation 1
+enum class ArffScaling { None, MinMax, ZScore };
+
+//
+// values[i] = values[i] * scale + shift over a column, with AVX-512 or AVX2 when the CPU has them,
+// picked once at run time, and plain code otherwise
+//
+#ifdef ARFFFILES_X86_KERNELS
+__attribute__((target("avx512f"))) inline void arffAffineAvx512(float* values, size_t size, float scale, float shift)
+{
+    const __m512 multiplier = _mm512_set1_ps(scale);
+    const __m512 offset = _mm512_set1_ps(shift);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512 value = _mm512_loadu_ps(values + i);
+        _mm512_storeu_ps(values + i, _mm512_add_ps(_mm512_mul_ps(value, multiplier), offset));
+    }
+    if (i < size) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (size - i)) - 1);
+        __m512 value = _mm512_maskz_loadu_ps(mask, values + i);
+        _mm512_mask_storeu_ps(values + i, mask, _mm512_add_ps(_mm512_mul_ps(value, multiplier), offset));
+    }
+}
+__attribute__((target("avx2"))) inline void arffAffineAvx2(float* values, size_t size, float scale, float shift)
+{
+    const __m256 multiplier = _mm256_set1_ps(scale);
+    const __m256 offset = _mm256_set1_ps(shift);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256 value = _mm256_loadu_ps(values + i);
+        _mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_mul_ps(value, multiplier), offset));
+    }
+    for (; i < size; i++)
+        values[i] = values[i] * scale + shift;
+}
+#endif
+inline void arffAffineScalar(float* values, size_t size, float scale, float shift)
+{
+    for (size_t i = 0; i < size; i++)
+        values[i] = values[i] * scale + shift;
+}
+inline void arffAffine(float* values, size_t size, float scale, float shift)
+{
+    using Kernel = void (*)(float*, size_t, float, float);
+    static const Kernel kernel = [] {
+#ifdef ARFFFILES_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return static_cast<Kernel>(arffAffineAvx512);
+        if (__builtin_cpu_supports("avx2"))
+            return static_cast<Kernel>(arffAffineAvx2);
+#endif
+        return static_cast<Kernel>(arffAffineScalar);
+        }();
+    kernel(values, size, scale, shift);
+}
+
+#endif
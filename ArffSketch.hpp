@@ -0,0 +1,320 @@
+#ifndef ARFFSKETCH_HPP
+#define ARFFSKETCH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+//
+// KLL quantile sketch: approximate ranks and quantiles of a stream of floats in O(k log(n / k)) memory,
+// with a rank error of about 1.7 / k. Values go to a hierarchy of compactors, level h holding values
+// that stand for 2^h of the input, and a full compactor sorts itself and promotes every other value.
+// Once the stream is long enough to afford it, only one random value of every block of 2^s goes in,
+// straight to level s, which saves sorting most of them. Sketches of disjoint parts of the data merge
+// into a sketch of the whole
+//
+class ArffQuantileSketch {
+public:
+    explicit ArffQuantileSketch(size_t k = 200, uint64_t seed = 0) : k(std::max<size_t>(k, 8)), random(seed * 2 + 1)
+    {
+        grow();
+    }
+    void add(float value)
+    {
+        if (std::isnan(value))
+            return;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        n++;
+        if (blockSeen++ == blockTarget)
+            candidate = value;
+        if (blockSeen == (size_t(1) << sampleLevel)) {
+            insert(sampleLevel, candidate);
+            blockSeen = 0;
+            while (n >= (samplingStart() << sampleLevel))
+                setSampleLevel(sampleLevel + 1);
+            blockTarget = sampleLevel == 0 ? 0 : next() & ((size_t(1) << sampleLevel) - 1);
+        }
+    }
+    void add(const float* values, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            add(values[i]);
+    }
+    // Values of blocks still being sampled are left out
+    void merge(const ArffQuantileSketch& other)
+    {
+        if (other.n == 0)
+            return;
+        size_t unsorted = std::max(sampleLevel, other.sampleLevel);
+        while (levels.size() < other.levels.size())
+            grow();
+        for (size_t h = 0; h < other.levels.size(); h++) {
+            size_t middle = levels[h].size();
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+            if (h > unsorted)
+                std::inplace_merge(levels[h].begin(), levels[h].begin() + middle, levels[h].end());
+        }
+        retained += other.retained;
+        weight += other.weight;
+        n += other.n;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        // Levels that aren't sorted yet keep the values of the levels below
+        if (unsorted > sampleLevel) {
+            blockSeen = 0;
+            setSampleLevel(unsorted);
+            blockTarget = next() & ((size_t(1) << sampleLevel) - 1);
+        }
+        while (retained >= limit)
+            compress();
+    }
+    size_t count() const { return n; }
+    float min() const { return minimum; }
+    float max() const { return maximum; }
+    // Values kept, what the sketch costs in memory
+    size_t size() const { return retained; }
+    // Value with about q * count() values below it, q in [0, 1]
+    float quantile(double q) const
+    {
+        if (n == 0)
+            throw std::logic_error("The sketch is empty");
+        if (q <= 0 || weight == 0)
+            return minimum;
+        if (q >= 1)
+            return maximum;
+        auto items = weighted();
+        double target = q * static_cast<double>(weight);
+        uint64_t cumulative = 0;
+        for (const auto& [value, itemWeight] : items) {
+            cumulative += itemWeight;
+            if (static_cast<double>(cumulative) >= target)
+                return value;
+        }
+        return maximum;
+    }
+    std::vector<float> quantiles(const std::vector<double>& qs) const
+    {
+        std::vector<float> result;
+        for (auto q : qs)
+            result.push_back(quantile(q));
+        return result;
+    }
+    // Fraction of the values less than or equal to value
+    double rank(float value) const
+    {
+        if (weight == 0)
+            return value >= minimum ? 1 : 0;
+        uint64_t below = 0;
+        for (size_t h = 0; h < levels.size(); h++) {
+            for (auto item : levels[h]) {
+                if (item <= value)
+                    below += uint64_t(1) << h;
+            }
+        }
+        return static_cast<double>(below) / static_cast<double>(weight);
+    }
+    // values * scale + shift, as done by ArffFiles::scale()
+    void transform(float scale, float shift)
+    {
+        for (auto& level : levels) {
+            for (auto& value : level)
+                value = value * scale + shift;
+            if (scale < 0)
+                std::reverse(level.begin(), level.end());
+        }
+        candidate = candidate * scale + shift;
+        if (n > 0) {
+            minimum = minimum * scale + shift;
+            maximum = maximum * scale + shift;
+            if (scale < 0)
+                std::swap(minimum, maximum);
+        }
+    }
+private:
+    // Values taken one by one, a few times k^2, before sampling starts: the rank error of the sample
+    // then stays about 1 / k
+    size_t samplingStart() const { return k * k / 2; }
+    // Lower levels get smaller compactors, (2/3)^depth of k, but the one where the values arrive keeps
+    // k so that compactions stay rare
+    size_t capacity(size_t h) const
+    {
+        if (h <= sampleLevel)
+            return k;
+        double depth = static_cast<double>(levels.size() - h - 1);
+        return static_cast<size_t>(std::ceil(static_cast<double>(k) * std::pow(2.0 / 3.0, depth))) + 1;
+    }
+    // Adds a level on top, the capacities depend on the number of levels
+    void grow()
+    {
+        levels.emplace_back();
+        updateLimit();
+    }
+    void setSampleLevel(size_t level)
+    {
+        sampleLevel = level;
+        updateLimit();
+    }
+    void updateLimit()
+    {
+        limit = 0;
+        for (size_t h = 0; h < levels.size(); h++)
+            limit += capacity(h);
+    }
+    void insert(size_t h, float value)
+    {
+        while (levels.size() <= h)
+            grow();
+        levels[h].push_back(value);
+        weight += uint64_t(1) << h;
+        if (++retained >= limit)
+            compress();
+    }
+    // Compacts the lowest full level into the next one
+    void compress()
+    {
+        for (size_t h = 0; h < levels.size(); h++) {
+            if (levels[h].size() < capacity(h))
+                continue;
+            if (h + 1 == levels.size())
+                grow();
+            auto& level = levels[h];
+            // Levels above the one sampled into only get sorted runs and are kept sorted
+            if (h <= sampleLevel)
+                std::sort(level.begin(), level.end());
+            // An odd value out stays
+            float kept = level.back();
+            bool odd = level.size() % 2 == 1;
+            size_t pairs = level.size() / 2;
+            size_t offset = next() & 1;
+            auto& above = levels[h + 1];
+            size_t middle = above.size();
+            for (size_t i = 0; i < pairs; i++)
+                above.push_back(level[2 * i + offset]);
+            if (h + 1 > sampleLevel)
+                std::inplace_merge(above.begin(), above.begin() + middle, above.end());
+            level.clear();
+            if (odd)
+                level.push_back(kept);
+            retained -= pairs;
+            return;
+        }
+    }
+    std::vector<std::pair<float, uint64_t>> weighted() const
+    {
+        std::vector<std::pair<float, uint64_t>> items;
+        items.reserve(retained);
+        for (size_t h = 0; h < levels.size(); h++) {
+            for (auto value : levels[h])
+                items.emplace_back(value, uint64_t(1) << h);
+        }
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+    // xorshift64, for the coin of every compaction and the value kept of every block
+    uint64_t next()
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return random;
+    }
+    size_t k;
+    uint64_t random;
+    std::vector<std::vector<float>> levels;
+    size_t retained = 0;
+    size_t limit = 0; // values kept that trigger a compaction
+    uint64_t weight = 0; // values the ones kept stand for
+    size_t n = 0;
+    size_t sampleLevel = 0;
+    size_t blockSeen = 0;
+    size_t blockTarget = 0;
+    float candidate = 0;
+    float minimum = std::numeric_limits<float>::infinity();
+    float maximum = -std::numeric_limits<float>::infinity();
+};
+
+//
+// Counts of values in bins of the same width over [low, high], the last bin closed. Values out of
+// the range are counted apart. Histograms with the same bins merge
+//
+class ArffHistogram {
+public:
+    ArffHistogram() = default;
+    ArffHistogram(size_t bins, float low, float high) : low(low), high(high), counts(bins, 0)
+    {
+        if (bins == 0 || !(low < high)) {
+            throw std::invalid_argument("A histogram needs at least one bin and low < high");
+        }
+    }
+    void add(float value)
+    {
+        if (std::isnan(value))
+            return;
+        if (value < low) {
+            underflow++;
+        } else if (value > high) {
+            overflow++;
+        } else {
+            auto bin = static_cast<size_t>((static_cast<double>(value) - low) / (static_cast<double>(high) - low) * static_cast<double>(counts.size()));
+            counts[std::min(bin, counts.size() - 1)]++;
+        }
+    }
+    void add(const float* values, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            add(values[i]);
+    }
+    void merge(const ArffHistogram& other)
+    {
+        if (other.counts.size() != counts.size() || other.low != low || other.high != high) {
+            throw std::invalid_argument("Only histograms with the same bins can be merged");
+        }
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+    }
+    bool empty() const { return counts.empty(); }
+    size_t bins() const { return counts.size(); }
+    float getLow() const { return low; }
+    float getHigh() const { return high; }
+    // Lower edge of bin, edge(bins()) is high
+    float edge(size_t bin) const { return static_cast<float>(low + (static_cast<double>(high) - low) * static_cast<double>(bin) / static_cast<double>(counts.size())); }
+    const std::vector<size_t>& getCounts() const { return counts; }
+    size_t getUnderflow() const { return underflow; }
+    size_t getOverflow() const { return overflow; }
+    // The same values after values * scale + shift with scale >= 0, as done by ArffFiles::scale().
+    // Scale 0 (a constant column) maps every value to shift: they all go to the first bin, which
+    // starts at shift and keeps its width
+    void transform(float scale, float shift)
+    {
+        if (empty() || !(scale >= 0))
+            return;
+        if (scale == 0) {
+            float width = high - low;
+            for (size_t i = 1; i < counts.size(); i++)
+                counts[0] += counts[i];
+            std::fill(counts.begin() + 1, counts.end(), 0);
+            counts[0] += underflow + overflow;
+            underflow = 0;
+            overflow = 0;
+            low = shift;
+            high = shift + width;
+            return;
+        }
+        low = low * scale + shift;
+        high = high * scale + shift;
+    }
+private:
+    float low = 0;
+    float high = 0;
+    std::vector<size_t> counts;
+    size_t underflow = 0;
+    size_t overflow = 0;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef ARFFSPLIT_HPP
+#define ARFFSPLIT_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include "ArffDataset.hpp"
+#include "ArffParallel.hpp"
+
+// Row numbers of each side of a split, in increasing order
+struct ArffSplit {
+    std::vector<size_t> train;
+    std::vector<size_t> test;
+};
+
+//
+// Stratified splits computed from the labels alone in O(n): rows are bucketed by class, each bucket
+// is shuffled with the seed and dealt to the folds. The same labels and seed give the same splits on
+// every platform, as the shuffle only relies on the mt19937_64 sequence
+//
+inline std::vector<std::vector<size_t>> arffClassBuckets(const std::vector<int>& y, uint64_t seed)
+{
+    int classes = 0;
+    for (auto label : y) {
+        if (label < 0)
+            throw std::invalid_argument("Labels must be non negative");
+        classes = std::max(classes, label + 1);
+    }
+    std::vector<size_t> counts(classes, 0);
+    for (auto label : y)
+        counts[label]++;
+    std::vector<std::vector<size_t>> buckets(classes);
+    for (int c = 0; c < classes; c++)
+        buckets[c].reserve(counts[c]);
+    for (size_t row = 0; row < y.size(); row++)
+        buckets[y[row]].push_back(row);
+    std::mt19937_64 generator(seed);
+    for (auto& bucket : buckets) {
+        for (size_t i = bucket.size(); i > 1; i--) {
+            std::swap(bucket[i - 1], bucket[generator() % i]);
+        }
+    }
+    return buckets;
+}
+// Each class is dealt from the fold where the previous one stopped, so fold sizes differ in one at most
+inline std::vector<ArffSplit> arffStratifiedKFold(const std::vector<int>& y, size_t k, uint64_t seed = 0)
+{
+    if (k < 2 || k > y.size()) {
+        throw std::invalid_argument("The number of folds must be between 2 and the number of rows");
+    }
+    auto buckets = arffClassBuckets(y, seed);
+    std::vector<uint32_t> fold(y.size());
+    size_t next = 0;
+    for (const auto& bucket : buckets) {
+        for (auto row : bucket) {
+            fold[row] = static_cast<uint32_t>(next);
+            next = (next + 1) % k;
+        }
+    }
+    std::vector<size_t> sizes(k, 0);
+    for (auto f : fold)
+        sizes[f]++;
+    std::vector<ArffSplit> folds(k);
+    for (size_t f = 0; f < k; f++) {
+        folds[f].test.reserve(sizes[f]);
+        folds[f].train.reserve(y.size() - sizes[f]);
+        for (size_t row = 0; row < y.size(); row++) {
+            (fold[row] == f ? folds[f].test : folds[f].train).push_back(row);
+        }
+    }
+    return folds;
+}
+// testSize is the fraction of the rows of each class that goes to test, rounded
+inline ArffSplit arffTrainTestSplit(const std::vector<int>& y, double testSize = 0.25, uint64_t seed = 0, bool stratified = true)
+{
+    if (!(testSize > 0 && testSize < 1)) {
+        throw std::invalid_argument("The test size must be between 0 and 1");
+    }
+    std::vector<std::vector<size_t>> buckets;
+    if (stratified) {
+        buckets = arffClassBuckets(y, seed);
+    } else {
+        buckets = arffClassBuckets(std::vector<int>(y.size(), 0), seed);
+    }
+    std::vector<bool> test(y.size(), false);
+    for (const auto& bucket : buckets) {
+        auto count = static_cast<size_t>(std::llround(static_cast<double>(bucket.size()) * testSize));
+        for (size_t i = 0; i < count; i++)
+            test[bucket[i]] = true;
+    }
+    ArffSplit split;
+    for (size_t row = 0; row < y.size(); row++) {
+        (test[row] ? split.test : split.train).push_back(row);
+    }
+    return split;
+}
+
+// Uniform keeps a random sample of the rows, Stratified one with the class proportions of the whole data
+enum class ArffSampling { None, Uniform, Stratified };
+
+//
+// Reservoir sampling (algorithm R) of up to capacity items seen one at a time, without knowing how many
+// there will be. offer() tells where the item goes: slots are handed out in order while there's room and
+// then reused at random, so the caller keeps the items in slots of its own. Stratified sampling keeps a
+// reservoir per group and, at the end, a random part of each proportional to how many items the group had
+//
+class ArffReservoir {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    ArffReservoir(size_t capacity, uint64_t seed = 0) : capacity(capacity), generator(seed) {}
+    // Slot for the item or npos if it's left out. A slot equal to slots() is a new one
+    size_t offer(size_t group = 0)
+    {
+        if (group >= groups.size())
+            groups.resize(group + 1);
+        auto& reservoir = groups[group];
+        size_t seen = reservoir.seen++;
+        total++;
+        if (reservoir.slots.size() < capacity) {
+            reservoir.slots.push_back(items.size());
+            items.push_back(total - 1);
+            return items.size() - 1;
+        }
+        size_t position = generator() % (seen + 1);
+        if (position >= capacity)
+            return npos;
+        size_t slot = reservoir.slots[position];
+        items[slot] = total - 1;
+        return slot;
+    }
+    size_t slots() const { return items.size(); }
+    size_t seen() const { return total; }
+    // Slots in the sample, in the order their items were offered
+    std::vector<size_t> select()
+    {
+        std::vector<size_t> kept;
+        if (groups.size() <= 1) {
+            kept = groups.empty() ? kept : groups[0].slots;
+        } else {
+            // Largest remainder, ties to the first group
+            std::vector<size_t> quotas(groups.size());
+            std::vector<std::pair<double, size_t>> remainders;
+            size_t target = std::min(capacity, total);
+            size_t assigned = 0;
+            for (size_t group = 0; group < groups.size(); group++) {
+                double share = static_cast<double>(target) * static_cast<double>(groups[group].seen) / static_cast<double>(total);
+                quotas[group] = static_cast<size_t>(share);
+                assigned += quotas[group];
+                remainders.emplace_back(quotas[group] - share, group);
+            }
+            std::sort(remainders.begin(), remainders.end());
+            for (size_t i = 0; assigned < target; i++, assigned++)
+                quotas[remainders[i].second]++;
+            for (size_t group = 0; group < groups.size(); group++) {
+                auto& slotsOfGroup = groups[group].slots;
+                for (size_t i = 0; i < quotas[group]; i++) {
+                    std::swap(slotsOfGroup[i], slotsOfGroup[i + generator() % (slotsOfGroup.size() - i)]);
+                    kept.push_back(slotsOfGroup[i]);
+                }
+            }
+        }
+        std::sort(kept.begin(), kept.end(), [this](size_t a, size_t b) { return items[a] < items[b]; });
+        return kept;
+    }
+private:
+    struct Group {
+        size_t seen = 0;
+        std::vector<size_t> slots;
+    };
+    size_t capacity;
+    std::mt19937_64 generator;
+    std::vector<Group> groups;
+    std::vector<size_t> items; // number of the item in each slot
+    size_t total = 0;
+};
+
+//
+// Subset of the rows of X and y seen through their row numbers, nothing is copied until gatherX() or gatherY().
+// It refers to the X and y given, which must outlive it, or keeps the dataset alive when built from one
+//
+class ArffView {
+public:
+    ArffView(const std::vector<std::vector<float>>& X, const std::vector<int>& y, std::vector<size_t> rows)
+        : X(X), y(y), rows(std::move(rows))
+    {
+        for (auto row : this->rows) {
+            if (row >= y.size())
+                throw std::out_of_range("Row " + std::to_string(row) + " out of range");
+        }
+    }
+    ArffView(std::shared_ptr<const ArffDataset> dataset, std::vector<size_t> rows)
+        : ArffView(dataset->getX(), dataset->getY(), std::move(rows))
+    {
+        owner = std::move(dataset);
+    }
+    size_t size() const { return rows.size(); }
+    size_t features() const { return X.size(); }
+    float operator()(size_t feature, size_t row) const { return X[feature][rows[row]]; }
+    int label(size_t row) const { return y[rows[row]]; }
+    const std::vector<size_t>& getRows() const { return rows; }
+    // 0 uses the hardware threads
+    ArffView& setThreads(size_t threads)
+    {
+        numThreads = threads;
+        return *this;
+    }
+    // The rows of the view as contiguous columns, feature major like X, the features split among the threads
+    std::vector<std::vector<float>> gatherX() const
+    {
+        std::vector<std::vector<float>> result(X.size());
+        arffParallelFor(X.size(), numThreads, [&](size_t feature) {
+            const auto& column = X[feature];
+            auto& target = result[feature];
+            target.resize(rows.size());
+            for (size_t i = 0; i < rows.size(); i++)
+                target[i] = column[rows[i]];
+            });
+        return result;
+    }
+    std::vector<int> gatherY() const
+    {
+        std::vector<int> result(rows.size());
+        for (size_t i = 0; i < rows.size(); i++)
+            result[i] = y[rows[i]];
+        return result;
+    }
+private:
+    const std::vector<std::vector<float>>& X;
+    const std::vector<int>& y;
+    std::vector<size_t> rows;
+    std::shared_ptr<const ArffDataset> owner;
+    size_t numThreads = 0;
+};
+
+#endif
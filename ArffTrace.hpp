@@ -0,0 +1,114 @@
+#ifndef ARFFTRACE_HPP
+#define ARFFTRACE_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+//
+// Spans of the hot paths of the loader. The ARFF_TRACE_SCOPE macro only records anything when
+// ARFFFILES_TRACING is defined (CMake option ARFFFILES_TRACING), otherwise it compiles to nothing.
+// Spans go to the process wide ArffTracer, that keeps them to be saved as a Chrome trace JSON file
+// (chrome://tracing, ui.perfetto.dev) or hands them to a sink to route them elsewhere
+//
+struct ArffTraceEvent {
+    const char* name;
+    int64_t startMicros; // since the tracer was created
+    int64_t durationMicros;
+    uint32_t thread;
+};
+
+class ArffTracer {
+public:
+    using Sink = std::function<void(const ArffTraceEvent&)>;
+    static ArffTracer& instance()
+    {
+        static ArffTracer tracer;
+        return tracer;
+    }
+    // With a sink events are not kept
+    void setSink(Sink callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sink = std::move(callback);
+    }
+    void record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        ArffTraceEvent event{ name, micros(start), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), threadId() };
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sink) {
+            sink(event);
+        } else {
+            events.push_back(event);
+        }
+    }
+    std::vector<ArffTraceEvent> getEvents() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return events;
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+    }
+    // Chrome trace event format, complete ("X") events
+    bool save(const std::string& fileName) const
+    {
+        std::ofstream file(fileName);
+        if (!file.is_open())
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        file << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); ++i) {
+            const auto& event = events[i];
+            file << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"arff\",\"ph\":\"X\",\"ts\":" << event.startMicros
+                << ",\"dur\":" << event.durationMicros << ",\"pid\":1,\"tid\":" << event.thread << "}";
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+private:
+    ArffTracer() : origin(std::chrono::steady_clock::now()) {}
+    int64_t micros(std::chrono::steady_clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - origin).count();
+    }
+    static uint32_t threadId()
+    {
+        static std::atomic<uint32_t> next{ 1 };
+        thread_local uint32_t id = next++;
+        return id;
+    }
+    std::chrono::steady_clock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<ArffTraceEvent> events;
+    Sink sink;
+};
+
+class ArffTraceScope {
+public:
+    explicit ArffTraceScope(const char* name) : name(name), start(std::chrono::steady_clock::now()) {}
+    ~ArffTraceScope() { ArffTracer::instance().record(name, start, std::chrono::steady_clock::now()); }
+    ArffTraceScope(const ArffTraceScope&) = delete;
+    ArffTraceScope& operator=(const ArffTraceScope&) = delete;
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define ARFF_TRACE_CONCAT_(a, b) a##b
+#define ARFF_TRACE_CONCAT(a, b) ARFF_TRACE_CONCAT_(a, b)
+#ifdef ARFFFILES_TRACING
+#define ARFF_TRACE_SCOPE(name) ArffTraceScope ARFF_TRACE_CONCAT(arffTraceScope, __LINE__)(name)
+#else
+#define ARFF_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef ARFFWRITER_HPP
+#define ARFFWRITER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <future>
+#include <thread>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include "ArffDataset.hpp"
+
+//
+// Writes a dataset as ARFF: the header from the attributes and nominal values and then the rows,
+// class last, so loading the file again with the class last gives back the same X, y and states.
+// Rows are formatted with std::to_chars in chunks, by several threads when there are many, and
+// written in big blocks. Sparse output leaves out the zeros (the first value of nominal attributes).
+// Weights other than 1 are written as {w} after the class
+//
+class ArffWriter {
+public:
+    ArffWriter(const std::vector<std::pair<std::string, std::string>>& attributes, const std::map<std::string, bool>& numeric_features,
+        const std::string& className, const std::vector<std::vector<float>>& X, const std::vector<int>& y,
+        const std::map<std::string, std::vector<std::string>>& dictionaries)
+        : attributes(attributes), numeric_features(numeric_features), className(className), X(X), y(y), dictionaries(dictionaries)
+    {
+    }
+    explicit ArffWriter(const ArffDataset& dataset)
+        : ArffWriter(dataset.getAttributes(), dataset.getNumericAttributes(), dataset.getClassName(), dataset.getX(), dataset.getY(),
+            dataset.getDictionaries())
+    {
+    }
+    ArffWriter& setRelation(const std::string& name)
+    {
+        relation = name;
+        return *this;
+    }
+    ArffWriter& setSparse(bool enabled)
+    {
+        sparse = enabled;
+        return *this;
+    }
+    // One per row, or none. Must outlive the writer
+    ArffWriter& setWeights(const std::vector<float>& rowWeights)
+    {
+        weights = &rowWeights;
+        return *this;
+    }
+    // 0 uses the hardware threads
+    ArffWriter& setThreads(size_t threads)
+    {
+        numThreads = threads;
+        return *this;
+    }
+    void save(const std::string& fileName) const
+    {
+        std::ofstream file(fileName, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::invalid_argument("Unable to create file");
+        }
+        write(file);
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Error writing file");
+        }
+    }
+    void write(std::ostream& output) const
+    {
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (X.size() != attributes.size() || X[i].size() != y.size()) {
+                throw std::invalid_argument("X must have a column of y.size() values for each attribute");
+            }
+        }
+        if (weights != nullptr && !weights->empty() && weights->size() != y.size()) {
+            throw std::invalid_argument("There must be a weight for each row");
+        }
+        const auto& labels = dictionaries.at(className);
+        std::string header = "@relation " + quote(relation) + "\n\n";
+        for (const auto& [name, type] : attributes) {
+            header += "@attribute " + quote(name) + " ";
+            header += numeric_features.at(name) ? type : nominalType(dictionaries.at(name));
+            header += "\n";
+        }
+        header += "@attribute " + quote(className) + " " + nominalType(labels) + "\n\n@data\n";
+        output.write(header.data(), header.size());
+        // Nominal values are quoted once here instead of for every row
+        std::vector<const std::vector<std::string>*> values(attributes.size(), nullptr);
+        std::map<std::string, std::vector<std::string>> quoted;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            const auto& name = attributes[i].first;
+            if (!numeric_features.at(name)) {
+                values[i] = &quoteAll(quoted[name], dictionaries.at(name));
+            }
+        }
+        const auto& classValues = quoteAll(quoted["\x01" + className], labels);
+        size_t workers = numThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : numThreads;
+        const size_t rows = y.size();
+        for (size_t first = 0; first < rows; first += workers * chunkRows) {
+            std::vector<std::future<std::string>> chunks;
+            for (size_t begin = first; begin < std::min(rows, first + workers * chunkRows); begin += chunkRows) {
+                size_t end = std::min(rows, begin + chunkRows);
+                auto format = [this, begin, end, &values, &classValues]() { return formatRows(begin, end, values, classValues); };
+                chunks.push_back(workers == 1 ? std::async(std::launch::deferred, format) : std::async(std::launch::async, format));
+            }
+            for (auto& chunk : chunks) {
+                auto text = chunk.get();
+                output.write(text.data(), text.size());
+            }
+        }
+    }
+private:
+    static constexpr size_t chunkRows = 16384;
+    std::string formatRows(size_t begin, size_t end, const std::vector<const std::vector<std::string>*>& values,
+        const std::vector<std::string>& classValues) const
+    {
+        std::string text;
+        text.reserve((end - begin) * (X.size() + 1) * 8);
+        char number[64];
+        for (size_t row = begin; row < end; row++) {
+            bool first = true;
+            if (sparse)
+                text += '{';
+            for (size_t i = 0; i < X.size(); i++) {
+                float value = X[i][row];
+                if (sparse && value == 0)
+                    continue;
+                if (!first)
+                    text += ',';
+                first = false;
+                if (sparse) {
+                    text.append(number, std::to_chars(number, number + sizeof(number), i).ptr);
+                    text += ' ';
+                }
+                if (values[i] != nullptr) {
+                    text += values[i]->at(static_cast<size_t>(value));
+                } else if (std::isnan(value)) {
+                    text += '?';
+                } else {
+                    text.append(number, formatFloat(number, number + sizeof(number), value));
+                }
+            }
+            if (!first)
+                text += ',';
+            if (sparse) {
+                text.append(number, std::to_chars(number, number + sizeof(number), X.size()).ptr);
+                text += ' ';
+            }
+            text += classValues.at(y[row]);
+            text += sparse ? "}" : "";
+            if (weights != nullptr && !weights->empty() && (*weights)[row] != 1) {
+                text += ",{";
+                text.append(number, formatFloat(number, number + sizeof(number), (*weights)[row]));
+                text += '}';
+            }
+            text += '\n';
+        }
+        return text;
+    }
+    // Shortest text that reads back as the same float
+    static char* formatFloat(char* first, char* last, float value)
+    {
+#if defined(__cpp_lib_to_chars)
+        return std::to_chars(first, last, value).ptr;
+#else
+        return first + std::snprintf(first, last - first, "%.9g", value);
+#endif
+    }
+    static std::string quote(const std::string& text)
+    {
+        bool plain = !text.empty() && text.find_first_of(" ,'\"{}%\t") == std::string::npos;
+        if (plain)
+            return text;
+        std::string result = "'";
+        for (char c : text) {
+            if (c == '\'' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "'";
+    }
+    static const std::vector<std::string>& quoteAll(std::vector<std::string>& target, const std::vector<std::string>& source)
+    {
+        for (const auto& value : source) {
+            target.push_back(quote(value));
+        }
+        return target;
+    }
+    static std::string nominalType(const std::vector<std::string>& values)
+    {
+        std::string type = "{";
+        for (size_t i = 0; i < values.size(); i++) {
+            type += (i > 0 ? "," : "") + quote(values[i]);
+        }
+        return type + "}";
+    }
+    const std::vector<std::pair<std::string, std::string>>& attributes;
+    const std::map<std::string, bool>& numeric_features;
+    const std::string& className;
+    const std::vector<std::vector<float>>& X;
+    const std::vector<int>& y;
+    const std::map<std::string, std::vector<std::string>>& dictionaries;
+    const std::vector<float>* weights = nullptr;
+    std::string relation = "data";
+    bool sparse = false;
+    size_t numThreads = 0;
+};
+
+#endif
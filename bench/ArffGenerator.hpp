@@ -0,0 +1,129 @@
+#ifndef ARFFGENERATOR_HPP
+#define ARFFGENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <charconv>
+
+//
+// Deterministic synthetic ARFF files for benchmarking. The same settings produce byte for byte
+// the same file on any platform, as it doesn't depend on the standard library distributions
+//
+struct ArffGeneratorSettings {
+    uint64_t rows = 100000;
+    int numeric = 10; // numeric attributes
+    int nominal = 5; // nominal attributes
+    int cardinality = 8; // values of each nominal attribute
+    int classes = 3;
+    double missing = 0.0; // probability of each cell being ?
+    uint64_t seed = 271828;
+};
+
+class ArffGenerator {
+public:
+    explicit ArffGenerator(const ArffGeneratorSettings& settings) : settings(settings), state(settings.seed) {}
+    // Writes the whole file in blocks of blockSize bytes, returns the number of bytes written
+    uint64_t write(std::ostream& output, size_t blockSize = 1 << 20)
+    {
+        std::string buffer = header();
+        uint64_t written = 0;
+        buffer.reserve(blockSize + 4096);
+        for (uint64_t row = 0; row < settings.rows; ++row) {
+            appendRow(buffer);
+            if (buffer.size() >= blockSize) {
+                output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                written += buffer.size();
+                buffer.clear();
+            }
+        }
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return written + buffer.size();
+    }
+    std::string generate()
+    {
+        std::string buffer = header();
+        for (uint64_t row = 0; row < settings.rows; ++row) {
+            appendRow(buffer);
+        }
+        return buffer;
+    }
+    std::string header() const
+    {
+        std::string text = "@relation synthetic\n\n";
+        for (int i = 0; i < settings.numeric; ++i) {
+            text += "@attribute num" + std::to_string(i) + " numeric\n";
+        }
+        for (int i = 0; i < settings.nominal; ++i) {
+            text += "@attribute nom" + std::to_string(i) + " {" + values("v", settings.cardinality) + "}\n";
+        }
+        text += "@attribute class {" + values("c", settings.classes) + "}\n\n@data\n";
+        return text;
+    }
+private:
+    static std::string values(const std::string& prefix, int count)
+    {
+        std::string text;
+        for (int i = 0; i < count; ++i) {
+            text += (i > 0 ? "," : "") + prefix + std::to_string(i);
+        }
+        return text;
+    }
+    // splitmix64
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    bool isMissing()
+    {
+        return settings.missing > 0 && static_cast<double>(next() >> 11) * 0x1.0p-53 < settings.missing;
+    }
+    void appendInteger(std::string& buffer, uint64_t value)
+    {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+    }
+    void appendRow(std::string& buffer)
+    {
+        for (int i = 0; i < settings.numeric; ++i) {
+            if (isMissing()) {
+                buffer += "?,";
+                continue;
+            }
+            // Fixed point values with up to 4 decimals in [-500, 500)
+            uint64_t value = next() % 10000000;
+            if (value < 5000000) {
+                buffer += '-';
+                value = 5000000 - value;
+            } else {
+                value -= 5000000;
+            }
+            appendInteger(buffer, value / 10000);
+            buffer += '.';
+            auto fraction = std::to_string(10000 + value % 10000);
+            buffer.append(fraction, 1, 4);
+            buffer += ',';
+        }
+        for (int i = 0; i < settings.nominal; ++i) {
+            if (isMissing()) {
+                buffer += "?,";
+                continue;
+            }
+            buffer += 'v';
+            appendInteger(buffer, next() % settings.cardinality);
+            buffer += ',';
+        }
+        buffer += 'c';
+        appendInteger(buffer, next() % settings.classes);
+        buffer += '\n';
+    }
+    ArffGeneratorSettings settings;
+    uint64_t state;
+};
+
+#endif
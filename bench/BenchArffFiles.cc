@@ -0,0 +1,340 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ArffFiles.hpp"
+#include "ArffGenerator.hpp"
+
+//
+// Run with --benchmark_counters_tabular=true to see MB/s (bytes_per_second) and rows/s (items_per_second)
+//
+static ArffGeneratorSettings settingsFor(int64_t rows)
+{
+    ArffGeneratorSettings settings;
+    settings.rows = static_cast<uint64_t>(rows);
+    return settings;
+}
+
+// The generated files live in a directory of their own under the temporary one, removed on exit
+class BenchFiles {
+public:
+    ~BenchFiles()
+    {
+        std::error_code error;
+        if (!directory.empty())
+            std::filesystem::remove_all(directory, error);
+    }
+    const std::string& forRows(int64_t rows)
+    {
+        auto& name = files[rows];
+        if (name.empty()) {
+            if (directory.empty()) {
+                directory = std::filesystem::temp_directory_path() / ("arff_bench_" + std::to_string(std::random_device()()));
+                std::filesystem::create_directories(directory);
+            }
+            name = (directory / ("bench_" + std::to_string(rows) + ".arff")).string();
+            std::ofstream output(name, std::ios::binary);
+            ArffGenerator(settingsFor(rows)).write(output);
+        }
+        return name;
+    }
+private:
+    std::filesystem::path directory;
+    std::map<int64_t, std::string> files;
+};
+
+static const std::string& datasetFile(int64_t rows)
+{
+    static BenchFiles files;
+    return files.forRows(rows);
+}
+
+// The parsing kernels are private, the benchmarks reach them through this friend
+struct ArffFilesBenchmark {
+    static void tokenize(std::string_view text, std::vector<std::string_view>& tokens) { ArffFiles::tokenize(text, ',', tokens); }
+    static float toFloat(std::string_view token) { return ArffFiles::toFloat(token); }
+    static std::vector<int> factorize(ArffFiles& arff, const std::string& feature, const std::vector<std::string>& labels)
+    {
+        return arff.factorizeLabels(feature, labels, std::pmr::get_default_resource());
+    }
+};
+
+static void BM_HeaderParse(benchmark::State& state)
+{
+    ArffGeneratorSettings settings;
+    settings.rows = 0;
+    settings.numeric = static_cast<int>(state.range(0));
+    settings.nominal = static_cast<int>(state.range(0));
+    auto text = ArffGenerator(settings).header();
+    ArffFiles arff;
+    for (auto _ : state) {
+        arff.loadFromBuffer(text);
+        benchmark::DoNotOptimize(arff.getAttributes().size());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.SetItemsProcessed(state.iterations() * (settings.numeric + settings.nominal + 1));
+}
+BENCHMARK(BM_HeaderParse)->Arg(100)->Arg(1000);
+
+static void BM_Tokenize(benchmark::State& state)
+{
+    auto text = ArffGenerator(settingsFor(1000)).generate();
+    std::vector<std::string> rows;
+    size_t bytes = 0;
+    std::string_view view(text);
+    view.remove_prefix(view.find("@data\n") + 6);
+    while (!view.empty()) {
+        auto end = view.find('\n');
+        rows.emplace_back(view.substr(0, end));
+        bytes += rows.back().size();
+        view.remove_prefix(end == std::string_view::npos ? view.size() : end + 1);
+    }
+    std::vector<std::string_view> tokens;
+    for (auto _ : state) {
+        for (const auto& row : rows) {
+            ArffFilesBenchmark::tokenize(row, tokens);
+            benchmark::DoNotOptimize(tokens.data());
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * rows.size());
+}
+BENCHMARK(BM_Tokenize);
+
+static void BM_NumericConversion(benchmark::State& state)
+{
+    std::vector<std::string> tokens;
+    size_t bytes = 0;
+    for (int i = 0; i < 10000; ++i) {
+        tokens.push_back(std::to_string(i * 0.731f - 2000.0f));
+        bytes += tokens.back().size();
+    }
+    for (auto _ : state) {
+        for (const auto& token : tokens) {
+            benchmark::DoNotOptimize(ArffFilesBenchmark::toFloat(token));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_NumericConversion);
+
+static void BM_Factorize(benchmark::State& state)
+{
+    ArffFiles arff;
+    arff.loadFromBuffer(ArffGenerator(settingsFor(1)).generate());
+    std::vector<std::string> labels;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        labels.push_back("v" + std::to_string((i * 7919) % 64));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ArffFilesBenchmark::factorize(arff, "nom0", labels));
+    }
+    state.SetItemsProcessed(state.iterations() * labels.size());
+}
+BENCHMARK(BM_Factorize)->Arg(100000);
+
+static void BM_Load(benchmark::State& state)
+{
+    const auto& fileName = datasetFile(state.range(0));
+    ArffFiles arff;
+    arff.setThreads(static_cast<size_t>(state.range(1)));
+    for (auto _ : state) {
+        arff.load(fileName);
+        benchmark::DoNotOptimize(arff.getX().data());
+    }
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(file.tellg()));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Load)->ArgsProduct({ { 100000, 1000000 }, { 1, 0 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Argument: k of the quantile sketches, 0 without them
+static void BM_LoadSketches(benchmark::State& state)
+{
+    const auto& fileName = datasetFile(1000000);
+    ArffFiles arff;
+    arff.setQuantileSketches(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        arff.load(fileName);
+        benchmark::DoNotOptimize(arff.getX().data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1000000);
+}
+BENCHMARK(BM_LoadSketches)->Arg(0)->Arg(200)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 1% of the rows, uniform or stratified
+static void BM_LoadSample(benchmark::State& state)
+{
+    const auto& fileName = datasetFile(1000000);
+    ArffFiles arff;
+    arff.collectStats(true);
+    arff.setSampling(static_cast<ArffSampling>(state.range(0)), 10000, 1);
+    for (auto _ : state) {
+        arff.load(fileName);
+        benchmark::DoNotOptimize(arff.getX().data());
+    }
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(file.tellg()));
+    state.counters["peak_MB"] = static_cast<double>(arff.getLoadStats().peakAllocatedBytes) / (1 << 20);
+}
+BENCHMARK(BM_LoadSample)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 100000 rows plus 30% of them again: plain load, row hashes, deduplication
+static void BM_LoadDedupe(benchmark::State& state)
+{
+    auto text = ArffGenerator(settingsFor(100000)).generate();
+    auto data = text.find("@data\n") + 6;
+    size_t end = data;
+    for (int i = 0; i < 30000; i++)
+        end = text.find('\n', end) + 1;
+    text += text.substr(data, end - data);
+    ArffFiles arff;
+    arff.collectStats(true);
+    arff.setRowHashes(state.range(0) == 1);
+    arff.setDeduplicate(state.range(0) == 2);
+    for (auto _ : state) {
+        arff.loadFromBuffer(text);
+        benchmark::DoNotOptimize(arff.getX().data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.counters["duplicates"] = static_cast<double>(arff.getLoadStats().rowsDuplicated);
+}
+BENCHMARK(BM_LoadDedupe)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The class and four nominal attributes as targets, in one load or one load each
+static void BM_LoadTargets(benchmark::State& state)
+{
+    const auto& fileName = datasetFile(1000000);
+    const std::vector<std::string> targets{ "class", "nom0", "nom1", "nom2", "nom3" };
+    ArffFiles arff;
+    for (auto _ : state) {
+        if (state.range(0) == 1) {
+            arff.load(fileName, targets);
+            benchmark::DoNotOptimize(arff.getYMatrix().data());
+        } else {
+            for (const auto& target : targets) {
+                arff.load(fileName, target);
+                benchmark::DoNotOptimize(arff.getY().data());
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1000000);
+}
+BENCHMARK(BM_LoadTargets)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_LoadFromBuffer(benchmark::State& state)
+{
+    auto text = ArffGenerator(settingsFor(state.range(0))).generate();
+    ArffFiles arff;
+    for (auto _ : state) {
+        arff.loadFromBuffer(text);
+        benchmark::DoNotOptimize(arff.getX().data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadFromBuffer)->Arg(100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_Save(benchmark::State& state)
+{
+    ArffFiles arff;
+    arff.load(datasetFile(state.range(0)));
+    auto dataset = arff.getDataset();
+    for (auto _ : state) {
+        std::ostringstream output;
+        ArffWriter(*dataset).setThreads(static_cast<size_t>(state.range(1))).write(output);
+        state.SetBytesProcessed(state.bytes_processed() + output.tellp());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Save)->ArgsProduct({ { 100000 }, { 1, 0 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_Scale(benchmark::State& state)
+{
+    std::vector<float> values(static_cast<size_t>(state.range(0)), 1.5f);
+    auto kernel = state.range(1) == 0 ? arffAffineScalar : arffAffine;
+    for (auto _ : state) {
+        kernel(values.data(), values.size(), 0.5f, 0.75f);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(float)));
+}
+// Second argument: 0 plain loop, 1 the kernel picked for the CPU
+BENCHMARK(BM_Scale)->ArgsProduct({ { 1 << 14, 1 << 20 }, { 0, 1 } });
+static void BM_Discretize(benchmark::State& state)
+{
+    const size_t rows = 1 << 18;
+    std::vector<std::vector<float>> X(8, std::vector<float>(rows));
+    std::vector<int> y(rows);
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution;
+    for (size_t row = 0; row < rows; row++) {
+        y[row] = static_cast<int>(row % 3);
+        for (auto& column : X)
+            column[row] = distribution(generator) + static_cast<float>(y[row]);
+    }
+    ArffDiscretizer discretizer(static_cast<ArffDiscretization>(state.range(0)), 8);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(discretizer.fit(X, y).transform(X));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows * X.size()));
+}
+// EqualWidth, EqualFrequency and MDLP
+BENCHMARK(BM_Discretize)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+static void BM_KFold(benchmark::State& state)
+{
+    const size_t rows = 1 << 20;
+    std::vector<std::vector<float>> X(8, std::vector<float>(rows, 1.0f));
+    std::vector<int> y(rows);
+    for (size_t row = 0; row < rows; row++)
+        y[row] = static_cast<int>(row % 5);
+    for (auto _ : state) {
+        for (auto& fold : arffStratifiedKFold(y, 10)) {
+            ArffView view(X, y, std::move(fold.train));
+            if (state.range(0) == 1)
+                benchmark::DoNotOptimize(view.gatherX());
+            benchmark::DoNotOptimize(view.size());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+// Argument: 1 also gathers the train rows of every fold
+BENCHMARK(BM_KFold)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+static void BM_Contingency(benchmark::State& state)
+{
+    const size_t rows = 1 << 17;
+    const size_t features = 256;
+    std::vector<std::vector<float>> X(features, std::vector<float>(rows));
+    std::vector<int> y(rows);
+    std::mt19937 generator(7);
+    for (size_t row = 0; row < rows; row++) {
+        y[row] = static_cast<int>(generator() % 3);
+        for (auto& column : X)
+            column[row] = static_cast<float>(generator() % 8);
+    }
+    std::vector<size_t> states(features, 8);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            // Plain counting, one cell at a time
+            for (const auto& column : X) {
+                std::vector<uint64_t> counts(8 * 3, 0);
+                for (size_t row = 0; row < rows; row++)
+                    counts[static_cast<size_t>(column[row]) * 3 + y[row]]++;
+                benchmark::DoNotOptimize(counts.data());
+            }
+        } else {
+            benchmark::DoNotOptimize(arffContingencies(X, states, y, 3, 1));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows * features));
+}
+// Argument: 0 plain loop, 1 ArffContingency
+BENCHMARK(BM_Contingency)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
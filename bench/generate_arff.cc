@@ -0,0 +1,58 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "ArffGenerator.hpp"
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " output.arff [--rows n] [--numeric n] [--nominal n] [--cardinality n]"
+        << " [--classes n] [--missing p] [--seed n]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    ArffGeneratorSettings settings;
+    for (int i = 2; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        if (option == "--rows") {
+            settings.rows = std::stoull(value);
+        } else if (option == "--numeric") {
+            settings.numeric = std::stoi(value);
+        } else if (option == "--nominal") {
+            settings.nominal = std::stoi(value);
+        } else if (option == "--cardinality") {
+            settings.cardinality = std::stoi(value);
+        } else if (option == "--classes") {
+            settings.classes = std::stoi(value);
+        } else if (option == "--missing") {
+            settings.missing = std::stod(value);
+        } else if (option == "--seed") {
+            settings.seed = std::stoull(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (settings.cardinality < 1 || settings.classes < 1) {
+        std::cerr << "Cardinality and classes must be positive" << std::endl;
+        return 1;
+    }
+    std::ofstream output(argv[1], std::ios::binary);
+    if (!output) {
+        std::cerr << "Unable to create " << argv[1] << std::endl;
+        return 1;
+    }
+    ArffGenerator generator(settings);
+    auto bytes = generator.write(output);
+    std::cout << "Written " << bytes << " bytes to " << argv[1] << std::endl;
+    return output ? 0 : 1;
+}
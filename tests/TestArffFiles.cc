@@ -2,8 +2,14 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/generators/catch_generators.hpp>
 #include "ArffFiles.hpp"
+#include "ArffCache.hpp"
+#include "ArffWriter.hpp"
+#include "ArffArrow.hpp"
 #include "arffFiles_config.h"
 #include <iostream>
+#include <set>
+#include <random>
+#include <numeric>
 
 class Paths {
 public:
@@ -145,4 +151,1359 @@ TEST_CASE("Adult dataset", "[ArffFiles]")
     REQUIRE(X[12][0] == 40);
     REQUIRE(X[13][0] == 0);
 }
-
+TEST_CASE("Asynchronous load", "[ArffFiles]")
+{
+    ArffFiles arff;
+    size_t calls = 0;
+    size_t lastBytes = 0;
+    size_t lastRows = 0;
+    size_t total = 0;
+    bool monotonic = true;
+    arff.setProgressCallback([&](size_t bytesRead, size_t totalBytes, size_t rowsRead) {
+        monotonic = monotonic && bytesRead >= lastBytes;
+        calls++;
+        lastBytes = bytesRead;
+        lastRows = rowsRead;
+        total = totalBytes;
+        }, 1000);
+    auto result = arff.loadAsync(Paths::datasets("adult"), std::string("class"));
+    result.get();
+    REQUIRE(arff.getSize() == 45222);
+    REQUIRE(arff.getLabels().size() == 2);
+    REQUIRE(monotonic);
+    REQUIRE(calls > 40);
+    REQUIRE(lastBytes == total);
+    REQUIRE(lastRows == 45222);
+}
+TEST_CASE("Cancel load", "[ArffFiles]")
+{
+    ArffFiles arff;
+    ArffFiles::CancellationToken token;
+    arff.setCancellationToken(token);
+    arff.setProgressCallback([&](size_t, size_t, size_t rowsRead) {
+        if (rowsRead > 1000)
+            token.cancel();
+        }, 100);
+    auto result = arff.loadAsync(Paths::datasets("adult"));
+    REQUIRE_THROWS_AS(result.get(), std::runtime_error);
+    REQUIRE(token.isCancelled());
+    token.reset();
+    arff.load(Paths::datasets("iris"));
+    REQUIRE(arff.getSize() == 150);
+}
+TEST_CASE("Pipelined read with tiny blocks", "[ArffFiles]")
+{
+    auto name = GENERATE("iris", "glass", "adult");
+    ArffFiles reference;
+    reference.setThreads(1);
+    reference.load(Paths::datasets(name));
+    ArffFiles arff;
+    arff.setReadAhead(7, 3);
+    arff.setThreads(4);
+    arff.load(Paths::datasets(name));
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getAttributes() == reference.getAttributes());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getStates() == reference.getStates());
+    REQUIRE_THROWS_AS(arff.setReadAhead(0, 1), std::invalid_argument);
+}
+TEST_CASE("Parse while reading", "[ArffFiles]")
+{
+    // Several chunks of rows for the parser threads
+    const size_t rows = 30000;
+    std::string text = "@relation chunks\n@attribute color {red,green,blue}\n@attribute a numeric\n@attribute b real\n@attribute class {yes,no}\n@data\n";
+    const std::vector<std::string> colors{ "red", "green", "blue" };
+    for (size_t i = 0; i < rows; i++) {
+        text += colors[i % 3] + "," + std::to_string(i) + "," + std::to_string(i % 10) + (i % 2 ? ",no" : ",yes") + (i % 7 ? "\n" : ",{2}\n");
+    }
+    auto threads = GENERATE(1, 4);
+    ArffFiles arff;
+    arff.setThreads(threads);
+    arff.setReadAhead(4096, 2);
+    arff.collectStats(true);
+    arff.loadFromBuffer(text);
+    REQUIRE(arff.getLoadStats().threads == static_cast<size_t>(threads));
+    REQUIRE(arff.getSize() == rows);
+    const auto& X = arff.getX();
+    for (size_t i = 0; i < rows; i++) {
+        if (X[0][i] != i % 3 || X[1][i] != i || X[2][i] != i % 10 || arff.getY()[i] != static_cast<int>(i % 2) || arff.getWeights()[i] != (i % 7 ? 1 : 2)) {
+            FAIL("Row " << i);
+        }
+    }
+    REQUIRE(arff.getColumnStats()[1].max == rows - 1);
+    REQUIRE(arff.getClassStats().frequencies == std::vector<size_t>{ rows / 2, rows / 2 });
+    // The class first, another target and a row that can't be parsed near the end
+    arff.loadFromBuffer(text, std::vector<std::string>{ "color", "b" });
+    REQUIRE(arff.getX().size() == 2);
+    REQUIRE(arff.getX()[0][rows - 1] == rows - 1);
+    REQUIRE(arff.getYMatrix()[2 * (rows - 1) + 1] == static_cast<int>((rows - 1) % 10));
+    REQUIRE_THROWS_AS(arff.loadFromBuffer(text + "red,1,2,yes,3\n" + text.substr(text.find("@data\n") + 6)), std::invalid_argument);
+}
+TEST_CASE("io_uring backend", "[ArffFiles]")
+{
+    auto name = GENERATE("iris", "adult");
+    auto backend = GENERATE(ArffIoBackend::Uring, ArffIoBackend::UringDirect);
+    ArffFiles reference;
+    reference.load(Paths::datasets(name));
+    ArffFiles arff;
+    arff.setIoBackend(backend);
+    arff.load(Paths::datasets(name));
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE_THROWS_AS(arff.load(Paths::datasets("nonexistent")), std::invalid_argument);
+}
+TEST_CASE("Compressed files", "[ArffFiles]")
+{
+    ArffFiles reference;
+    reference.load(Paths::datasets("glass"), std::string("Type"));
+    auto extension = GENERATE(".gz", ".xz", ".zst");
+    auto threads = GENERATE(1, 4);
+    ArffFiles arff;
+    arff.setThreads(threads);
+    auto fileName = Paths::datasets("glass") + extension;
+    bool enabled = true;
+#ifndef ARFFFILES_USE_ZLIB
+    enabled = enabled && std::string(extension) != ".gz";
+#endif
+#ifndef ARFFFILES_USE_LZMA
+    enabled = enabled && std::string(extension) != ".xz";
+#endif
+#ifndef ARFFFILES_USE_ZSTD
+    enabled = enabled && std::string(extension) != ".zst";
+#endif
+    if (!enabled) {
+        REQUIRE_THROWS_AS(arff.load(fileName, std::string("Type")), std::invalid_argument);
+        return;
+    }
+    arff.load(fileName, std::string("Type"));
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getStates() == reference.getStates());
+    std::ifstream file(fileName, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ArffFiles fromBuffer;
+    fromBuffer.loadFromBuffer(content, std::string("Type"));
+    REQUIRE(fromBuffer.getX() == reference.getX());
+}
+TEST_CASE("Load from buffer and stream", "[ArffFiles]")
+{
+    ArffFiles reference;
+    reference.load(Paths::datasets("glass"), std::string("Type"));
+    std::ifstream file(Paths::datasets("glass"), std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ArffFiles arff;
+    arff.loadFromBuffer(content, std::string("Type"));
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getStates() == reference.getStates());
+    std::istringstream stream(content);
+    ArffFiles fromStream;
+    fromStream.setReadAhead(100, 2);
+    fromStream.loadFromStream(stream, std::string("Type"));
+    REQUIRE(fromStream.getLines() == reference.getLines());
+    REQUIRE(fromStream.getX() == reference.getX());
+    REQUIRE(fromStream.getY() == reference.getY());
+    arff.loadFromBuffer("@attribute a numeric\n@attribute class {x,y}\n@data\n1,x\n2,y");
+    REQUIRE(arff.getSize() == 2);
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 2 });
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1 });
+    REQUIRE_THROWS_AS(arff.loadFromBuffer(""), std::invalid_argument);
+}
+TEST_CASE("Load statistics", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.load(Paths::datasets("iris"));
+    REQUIRE(arff.getLoadStats().totalSeconds == 0);
+    arff.collectStats(true);
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    auto stats = arff.getLoadStats();
+    REQUIRE(stats.rowsKept == 45222);
+    REQUIRE(stats.rowsDropped == 3620);
+    REQUIRE(stats.bytesRead == 5962724);
+    REQUIRE(stats.threads >= 1);
+    REQUIRE(stats.peakAllocatedBytes > stats.bytesRead);
+    REQUIRE(stats.ioSeconds > 0);
+    REQUIRE(stats.headerSeconds > 0);
+    REQUIRE(stats.parseSeconds > 0);
+    REQUIRE(stats.tokenizeSeconds > 0);
+    REQUIRE(stats.conversionSeconds > 0);
+    REQUIRE(stats.factorizeSeconds > 0);
+    REQUIRE(stats.totalSeconds >= stats.ioSeconds + stats.parseSeconds + stats.factorizeSeconds);
+}
+TEST_CASE("Tracing", "[ArffFiles]")
+{
+    auto& tracer = ArffTracer::instance();
+    tracer.clear();
+    {
+        ArffTraceScope scope("test.span");
+    }
+    ArffFiles arff;
+    arff.load(Paths::datasets("iris"));
+    auto events = tracer.getEvents();
+    auto count = [&events](const std::string& name) {
+        return std::count_if(events.begin(), events.end(), [&name](const ArffTraceEvent& event) { return name == event.name; });
+        };
+    REQUIRE(count("test.span") == 1);
+#ifdef ARFFFILES_TRACING
+    REQUIRE(count("arff.io") == 1);
+    REQUIRE(count("arff.read") >= 1);
+    REQUIRE(count("arff.parse") == 1);
+    REQUIRE(count("arff.tokenize") == 1);
+    REQUIRE(count("arff.factorize") == 1);
+#else
+    REQUIRE(events.size() == 1);
+#endif
+    auto fileName = std::string("trace_test.json");
+    REQUIRE(tracer.save(fileName));
+    std::ifstream file(fileName);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    REQUIRE(content.find("\"name\":\"test.span\"") != std::string::npos);
+    std::remove(fileName.c_str());
+    tracer.clear();
+}
+TEST_CASE("Memory resource", "[ArffFiles]")
+{
+    // Counts what the loader asks for to check everything goes through the given resource
+    class Counter : public std::pmr::memory_resource {
+    public:
+        size_t allocations = 0;
+        size_t live = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            allocations++;
+            live += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            live -= bytes;
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    } counter;
+    ArffFiles reference;
+    reference.load(Paths::datasets("adult"), std::string("class"));
+    {
+        ArffFiles arff(&counter);
+        arff.collectStats(true);
+        arff.load(Paths::datasets("adult"), std::string("class"));
+        REQUIRE(counter.allocations > 0);
+        // A handful of big blocks instead of one allocation per line and token
+        REQUIRE(counter.allocations < 64);
+        REQUIRE(arff.getLoadStats().peakAllocatedBytes >= counter.live);
+        REQUIRE(arff.getLines() == reference.getLines());
+        REQUIRE(arff.getX() == reference.getX());
+        REQUIRE(arff.getY() == reference.getY());
+        REQUIRE(arff.getStates() == reference.getStates());
+        auto copy = arff;
+        arff.load(Paths::datasets("iris"));
+        REQUIRE(copy.getSize() == 45222);
+        REQUIRE(copy.getLines() == reference.getLines());
+    }
+    REQUIRE(counter.live == 0);
+}
+TEST_CASE("Refresh appended rows", "[ArffFiles]")
+{
+    const std::string fileName = "refresh_test.arff";
+    const std::string header = "@relation follow\n@attribute a numeric\n@attribute color {red,green,blue}\n@attribute class {yes,no}\n@data\n";
+    auto write = [&fileName](const std::string& text, std::ios::openmode mode) {
+        std::ofstream output(fileName, std::ios::binary | mode);
+        output << text;
+    };
+    write(header + "1.5,red,yes\n2.5,green,no\n3.5,gr", std::ios::trunc);
+    ArffFiles arff;
+    arff.load(fileName);
+    REQUIRE(arff.getSize() == 3);
+    REQUIRE(arff.refresh() == 0);
+    REQUIRE(arff.getSize() == 3);
+    REQUIRE(arff.getY().size() == 3);
+    // Completes the partial row and adds new labels, a missing value and a line still being written
+    write("een,yes\n% comment\n4.5,blue,maybe\n5.5,?,no\n6.5,red,", std::ios::app);
+    REQUIRE(arff.refresh() == 2);
+    write("no\n", std::ios::app);
+    REQUIRE(arff.refresh() == 1);
+    ArffFiles reference;
+    reference.load(fileName);
+    REQUIRE(arff.getSize() == 5);
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getStates() == reference.getStates());
+    // A copy keeps the rows it had
+    auto copy = arff;
+    write("7.5,blue,yes\n", std::ios::app);
+    REQUIRE(arff.refresh() == 1);
+    REQUIRE(arff.getSize() == 6);
+    REQUIRE(copy.getSize() == 5);
+    REQUIRE(copy.getLines() == reference.getLines());
+    write(header, std::ios::trunc);
+    REQUIRE_THROWS_AS(arff.refresh(), std::out_of_range);
+    std::remove(fileName.c_str());
+    ArffFiles buffer;
+    buffer.loadFromBuffer(header + "1,red,yes\n");
+    REQUIRE_THROWS_AS(buffer.refresh(), std::logic_error);
+}
+TEST_CASE("Refresh a file without a trailing newline", "[ArffFiles]")
+{
+    const std::string fileName = "refresh_newline_test.arff";
+    const std::string header = "@relation follow\n@attribute a numeric\n@attribute class {yes,no}\n@data\n";
+    auto write = [&fileName](const std::string& text, std::ios::openmode mode) {
+        std::ofstream output(fileName, std::ios::binary | mode);
+        output << text;
+    };
+    write(header + "1,yes\n2,no\n3,n", std::ios::trunc);
+    ArffFiles arff;
+    arff.load(fileName);
+    REQUIRE(arff.getSize() == 3);
+    // The last row stays while nothing is appended to it
+    REQUIRE(arff.refresh() == 0);
+    REQUIRE(arff.refresh() == 0);
+    REQUIRE(arff.getSize() == 3);
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 2, 3 });
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1, 2 });
+    // A longer version of it replaces it, still without a newline
+    write("o", std::ios::app);
+    REQUIRE(arff.refresh() == 0);
+    REQUIRE(arff.getSize() == 3);
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1, 1 });
+    REQUIRE(arff.getLabels().size() == 2);
+    write("\n4,no\n", std::ios::app);
+    REQUIRE(arff.refresh() == 2);
+    ArffFiles reference;
+    reference.load(fileName);
+    REQUIRE(arff.getSize() == 4);
+    REQUIRE(arff.getLines() == reference.getLines());
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getStates() == reference.getStates());
+    std::remove(fileName.c_str());
+}
+TEST_CASE("Dataset cache", "[ArffFiles]")
+{
+    ArffCache cache;
+    auto iris = cache.load(Paths::datasets("iris"));
+    REQUIRE(iris->getSize() == 150);
+    REQUIRE(cache.load(Paths::datasets("iris")) == iris);
+    REQUIRE(cache.load(Paths::datasets("iris"), false) != iris);
+    REQUIRE(cache.load(Paths::datasets("iris"), std::string("class")) != iris);
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.getHits() == 1);
+    REQUIRE(cache.getMisses() == 3);
+    REQUIRE(cache.getUsage() >= 3 * iris->getMemoryUsage());
+    // Options that change the dataset are part of the key
+    ArffLoadOptions options;
+    options.sampling = ArffSampling::Uniform;
+    options.sampleRows = 10;
+    options.sampleSeed = 1;
+    auto sample = cache.load(Paths::datasets("iris"), true, options);
+    REQUIRE(sample->getSize() == 10);
+    REQUIRE(cache.load(Paths::datasets("iris"), true, options) == sample);
+    options.sampleSeed = 2;
+    REQUIRE(cache.load(Paths::datasets("iris"), true, options) != sample);
+    options = ArffLoadOptions();
+    options.scaling = ArffScaling::MinMax;
+    auto scaled = cache.load(Paths::datasets("iris"), true, options);
+    REQUIRE(scaled != iris);
+    REQUIRE(*std::max_element(scaled->getX()[0].begin(), scaled->getX()[0].end()) == Catch::Approx(1));
+    options = ArffLoadOptions();
+    options.deduplicate = true;
+    REQUIRE(cache.load(Paths::datasets("iris"), true, options)->getSize() < 150);
+    REQUIRE(cache.load(Paths::datasets("iris"), true, ArffLoadOptions()) == iris);
+    // A modified file is loaded again
+    const std::string fileName = "cache_test.arff";
+    {
+        std::ofstream output(fileName, std::ios::binary);
+        output << "@relation cache\n@attribute a numeric\n@attribute class {yes,no}\n@data\n1,yes\n";
+    }
+    auto first = cache.load(fileName);
+    REQUIRE(first->getSize() == 1);
+    {
+        std::ofstream output(fileName, std::ios::binary | std::ios::app);
+        output << "2,no\n";
+    }
+    auto second = cache.load(fileName);
+    REQUIRE(second != first);
+    REQUIRE(second->getSize() == 2);
+    REQUIRE(first->getSize() == 1);
+    std::remove(fileName.c_str());
+    REQUIRE_THROWS_AS(cache.load(fileName), std::invalid_argument);
+    // The least recently used go first when over the budget
+    cache.clear();
+    REQUIRE(cache.getUsage() == 0);
+    auto glass = cache.load(Paths::datasets("glass"));
+    iris = cache.load(Paths::datasets("iris"));
+    cache.load(Paths::datasets("glass"));
+    cache.setBudget(glass->getMemoryUsage());
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.load(Paths::datasets("glass")) == glass);
+    REQUIRE(cache.load(Paths::datasets("iris")) != iris);
+    // Too big for the budget, not kept
+    cache.setBudget(1);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.load(Paths::datasets("iris"))->getSize() == 150);
+    REQUIRE(cache.size() == 0);
+}
+TEST_CASE("Immutable dataset", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.load(Paths::datasets("glass"), std::string("Type"));
+    auto dataset = arff.getDataset();
+    REQUIRE(dataset->getSize() == arff.getSize());
+    REQUIRE(dataset->getX() == arff.getX());
+    REQUIRE(dataset->getY() == arff.getY());
+    REQUIRE(dataset->getStates() == arff.getStates());
+    REQUIRE(dataset->getClassName() == "Type");
+    REQUIRE(dataset->getLabels() == arff.getLabels());
+    REQUIRE(dataset->getAttributes() == arff.getAttributes());
+    REQUIRE(dataset->getNumericAttributes() == arff.getNumericAttributes());
+    // Later loads don't change it
+    arff.load(Paths::datasets("iris"));
+    REQUIRE(dataset->getSize() == 214);
+    REQUIRE(dataset->getX().size() == 9);
+    // Read from several threads at once
+    std::vector<std::future<double>> sums;
+    for (int i = 0; i < 8; i++) {
+        sums.push_back(std::async(std::launch::async, [dataset]() {
+            double sum = 0;
+            for (const auto& column : dataset->getX())
+                for (auto value : column)
+                    sum += value;
+            return sum;
+            }));
+    }
+    auto expected = sums[0].get();
+    for (size_t i = 1; i < sums.size(); i++) {
+        REQUIRE(sums[i].get() == expected);
+    }
+    auto released = arff.releaseDataset();
+    REQUIRE(released->getSize() == 150);
+    REQUIRE(released->getClassName() == "class");
+    REQUIRE(arff.getSize() == 0);
+    REQUIRE(arff.getX().empty());
+    REQUIRE_THROWS_AS(ArffDataset({ { "a", "numeric" } }, {}, "class", "", {}, {}, {}), std::invalid_argument);
+}
+TEST_CASE("Save", "[ArffFiles]")
+{
+    const std::string fileName = "save_test.arff";
+    auto dataset = GENERATE(std::string("iris"), std::string("glass"), std::string("adult"), std::string("kdd_JapaneseVowels"));
+    auto threads = GENERATE(1, 0);
+    ArffFiles arff;
+    arff.setThreads(threads);
+    arff.load(Paths::datasets(dataset));
+    arff.save(fileName);
+    ArffFiles saved;
+    saved.load(fileName);
+    REQUIRE(saved.getClassName() == arff.getClassName());
+    REQUIRE(saved.getAttributes().size() == arff.getAttributes().size());
+    REQUIRE(saved.getNumericAttributes() == arff.getNumericAttributes());
+    REQUIRE(saved.getX() == arff.getX());
+    REQUIRE(saved.getY() == arff.getY());
+    REQUIRE(saved.getStates() == arff.getStates());
+    std::remove(fileName.c_str());
+}
+TEST_CASE("Save sparse", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.loadFromBuffer("@relation s\n@attribute a numeric\n@attribute b {x,'y z'}\n@attribute class {1,2}\n@data\n0,x,1\n2.5,'y z',2\n0,'y z',1\n");
+    std::ostringstream dense;
+    ArffWriter(*arff.getDataset()).setRelation("s").write(dense);
+    REQUIRE(dense.str() == "@relation s\n\n@attribute a numeric\n@attribute b {x,'y z'}\n@attribute class {1,2}\n\n@data\n0,x,1\n2.5,'y z',2\n0,'y z',1\n");
+    std::ostringstream sparse;
+    ArffWriter(*arff.getDataset()).setRelation("s").setSparse(true).write(sparse);
+    REQUIRE(sparse.str().substr(sparse.str().find("@data")) == "@data\n{2 1}\n{0 2.5,1 'y z',2 2}\n{1 'y z',2 1}\n");
+    REQUIRE_THROWS_AS(arff.save("/nonexistent/save_test.arff"), std::invalid_argument);
+}
+TEST_CASE("Rows with more values than attributes", "[ArffFiles]")
+{
+    const std::string header = "@attribute a numeric\n@attribute class {1,2}\n@data\n";
+    ArffFiles arff;
+    // A quoted value with a comma splits in two
+    REQUIRE_THROWS_WITH(arff.loadFromBuffer(header + "1,'x,y',2\n"), "Too many values in line: 1,'x,y',2");
+    REQUIRE_THROWS_WITH(arff.loadFromBuffer(header + "1,2\n3,1,4\n", std::string("a")), "Too many values in line: 3,1,4");
+    // Found by whichever parser thread gets the row
+    std::string rows;
+    for (int i = 0; i < 30000; i++)
+        rows += i == 20000 ? "1,2,3\n" : "1,2\n";
+    arff.setThreads(3);
+    REQUIRE_THROWS_WITH(arff.loadFromBuffer(header + rows), "Too many values in line: 1,2,3");
+    arff.loadFromBuffer(header + "1,2\n3,1\n");
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 3 });
+}
+TEST_CASE("Export", "[ArffFiles]")
+{
+    auto readFile = [](const std::string& fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::remove(fileName.c_str());
+        return text;
+    };
+    ArffFiles arff;
+    arff.loadFromBuffer("@relation e\n@attribute a numeric\n@attribute b {x,'y z'}\n@attribute class {1,2}\n@data\n0.5,x,1\n-2,'y z',2\n1e-3,x,2\n");
+    SECTION("npy")
+    {
+        auto layout = GENERATE(ArffLayout::FeatureMajor, ArffLayout::SampleMajor);
+        arff.exporter().setLayout(layout).saveNpy("export_X.npy", "export_y.npy");
+        auto x = readFile("export_X.npy");
+        auto y = readFile("export_y.npy");
+        REQUIRE(x.substr(0, 8) == std::string("\x93NUMPY\x01\x00", 8));
+        size_t headerLength = static_cast<unsigned char>(x[8]) + 256 * static_cast<unsigned char>(x[9]);
+        REQUIRE((10 + headerLength) % 64 == 0);
+        auto header = x.substr(10, headerLength);
+        if (layout == ArffLayout::FeatureMajor) {
+            REQUIRE(header.find("'fortran_order': False, 'shape': (2, 3)") != std::string::npos);
+        } else {
+            REQUIRE(header.find("'fortran_order': True, 'shape': (3, 2)") != std::string::npos);
+        }
+        std::vector<float> values((x.size() - 10 - headerLength) / sizeof(float));
+        std::memcpy(values.data(), x.data() + 10 + headerLength, values.size() * sizeof(float));
+        REQUIRE(values == std::vector<float>{ 0.5f, -2.0f, 1e-3f, 0.0f, 1.0f, 0.0f });
+        REQUIRE(y.find("'descr': '<i4', 'fortran_order': False, 'shape': (3,)") != std::string::npos);
+        REQUIRE((y.size() - 3 * sizeof(int)) % 64 == 0);
+    }
+    SECTION("npz")
+    {
+        arff.exporter().saveNpz("export.npz");
+        auto zip = readFile("export.npz");
+        REQUIRE(zip.substr(0, 4) == "PK\x03\x04");
+        REQUIRE(zip.find("X.npy") == 30);
+        REQUIRE(zip.find("y.npy") != std::string::npos);
+        // The CRC of X.npy in the central directory matches its data
+        auto central = zip.find("PK\x01\x02");
+        REQUIRE(central != std::string::npos);
+        uint32_t crc;
+        std::memcpy(&crc, zip.data() + central + 16, sizeof(crc));
+        uint32_t size;
+        std::memcpy(&size, zip.data() + central + 20, sizeof(size));
+        REQUIRE((size - 6 * sizeof(float)) % 64 == 0);
+        uint32_t expected = 0xffffffffu;
+        for (size_t i = 0; i < size; i++) {
+            expected ^= static_cast<unsigned char>(zip[35 + i]);
+            for (int bit = 0; bit < 8; bit++)
+                expected = (expected & 1) ? 0xedb88320u ^ (expected >> 1) : expected >> 1;
+        }
+        REQUIRE(crc == ~expected);
+        REQUIRE(zip.substr(zip.size() - 22, 4) == "PK\x05\x06");
+        uint32_t directorySize;
+        std::memcpy(&directorySize, zip.data() + zip.size() - 10, sizeof(directorySize));
+        uint32_t directoryOffset;
+        std::memcpy(&directoryOffset, zip.data() + zip.size() - 6, sizeof(directoryOffset));
+        REQUIRE(directoryOffset == central);
+        REQUIRE(directoryOffset + directorySize == zip.size() - 22);
+    }
+    SECTION("csv and schema")
+    {
+        arff.exporter().saveCsv("export.csv");
+        REQUIRE(readFile("export.csv") == "a,b,class\n0.5,x,1\n-2,y z,2\n0.001,x,2\n");
+        arff.exporter().saveSchema("export.json");
+        REQUIRE(readFile("export.json") == "{\n  \"samples\": 3,\n  \"layout\": \"feature_major\",\n  \"class\": {\"name\": \"class\", \"values\": [\"1\", \"2\"]},\n"
+            "  \"attributes\": [\n    {\"name\": \"a\", \"type\": \"numeric\"},\n    {\"name\": \"b\", \"type\": \"nominal\", \"values\": [\"x\", \"y z\"]}\n  ]\n}\n");
+    }
+    REQUIRE_THROWS_AS(arff.exporter().saveCsv("/nonexistent/export.csv"), std::invalid_argument);
+}
+TEST_CASE("Arrow C data interface", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.load(Paths::datasets("kdd_JapaneseVowels"));
+    auto dataset = arff.getDataset();
+    ArrowSchema schema;
+    ArrowArray array;
+    ArffArrow::exportDataset(dataset, &schema, &array);
+    REQUIRE(std::string(schema.format) == "+s");
+    REQUIRE(schema.n_children == static_cast<int64_t>(dataset->getAttributes().size() + 1));
+    REQUIRE(array.length == static_cast<int64_t>(dataset->getSize()));
+    // Numeric columns and the class point into the dataset
+    REQUIRE(std::string(schema.children[1]->format) == "f");
+    REQUIRE(array.children[1]->buffers[1] == dataset->getX()[1].data());
+    auto* label = array.children[schema.n_children - 1];
+    REQUIRE(std::string(schema.children[schema.n_children - 1]->format) == "i");
+    REQUIRE(label->buffers[1] == dataset->getY().data());
+    REQUIRE(std::string(schema.children[schema.n_children - 1]->dictionary->format) == "u");
+    REQUIRE(label->dictionary->length == static_cast<int64_t>(dataset->getLabels().size()));
+    // A column moved out by the consumer outlives the rest
+    ArrowArray moved = *array.children[1];
+    array.children[1]->release = nullptr;
+    auto imported = ArffArrow::importDataset(&schema, &array);
+    REQUIRE(schema.release == nullptr);
+    REQUIRE(array.release == nullptr);
+    dataset.reset();
+    REQUIRE(static_cast<const float*>(moved.buffers[1])[0] == arff.getX()[1][0]);
+    moved.release(&moved);
+    REQUIRE(moved.release == nullptr);
+    REQUIRE(imported->getX() == arff.getX());
+    REQUIRE(imported->getY() == arff.getY());
+    REQUIRE(imported->getStates() == arff.getStates());
+    REQUIRE(imported->getNumericAttributes() == arff.getNumericAttributes());
+    REQUIRE(imported->getClassName() == arff.getClassName());
+}
+TEST_CASE("Arrow import", "[ArffFiles]")
+{
+    // A string column, a double one with a null and a class of int64, all from the second row on
+    std::vector<int32_t> offsets{ 0, 1, 2, 4, 5 };
+    std::string characters = "abcda";
+    std::vector<double> numbers{ 9.0, 1.5, 2.5, 3.5 };
+    std::vector<uint8_t> validity{ 0b1011 };
+    std::vector<int64_t> classes{ 0, 7, 8, 7 };
+    std::vector<const void*> stringBuffers{ nullptr, offsets.data(), characters.data() };
+    std::vector<const void*> numberBuffers{ validity.data(), numbers.data() };
+    std::vector<const void*> classBuffers{ nullptr, classes.data() };
+    std::vector<const void*> rootBuffers{ nullptr };
+    auto noRelease = [](auto* released) { released->release = nullptr; };
+    using ReleaseSchema = void (*)(ArrowSchema*);
+    using ReleaseArray = void (*)(ArrowArray*);
+    ReleaseSchema releaseSchema = noRelease;
+    ReleaseArray releaseArray = noRelease;
+    ArrowSchema columnSchemas[3] = { { "u", "s", nullptr, 2, 0, nullptr, nullptr, releaseSchema, nullptr },
+        { "g", "n", nullptr, 2, 0, nullptr, nullptr, releaseSchema, nullptr }, { "l", "class", nullptr, 2, 0, nullptr, nullptr, releaseSchema, nullptr } };
+    ArrowArray columnArrays[3] = { { 4, 0, 0, 3, 0, stringBuffers.data(), nullptr, nullptr, releaseArray, nullptr },
+        { 4, 1, 0, 2, 0, numberBuffers.data(), nullptr, nullptr, releaseArray, nullptr },
+        { 4, 0, 0, 2, 0, classBuffers.data(), nullptr, nullptr, releaseArray, nullptr } };
+    ArrowSchema* schemaChildren[3] = { &columnSchemas[0], &columnSchemas[1], &columnSchemas[2] };
+    ArrowArray* arrayChildren[3] = { &columnArrays[0], &columnArrays[1], &columnArrays[2] };
+    ArrowSchema schema{ "+s", "", nullptr, 0, 3, schemaChildren, nullptr, releaseSchema, nullptr };
+    ArrowArray array{ 3, 0, 1, 1, 3, rootBuffers.data(), arrayChildren, nullptr, releaseArray, nullptr };
+    auto dataset = ArffArrow::importDataset(&schema, &array);
+    REQUIRE(schema.release == nullptr);
+    REQUIRE(dataset->getSize() == 2);
+    REQUIRE(dataset->getX() == std::vector<std::vector<float>>{ { 0, 1 }, { 1.5f, 3.5f } });
+    REQUIRE(dataset->getY() == std::vector<int>{ 0, 0 });
+    REQUIRE(dataset->getDictionaries().at("s") == std::vector<std::string>{ "b", "a" });
+    REQUIRE(dataset->getLabels() == std::vector<std::string>{ "Class 7" });
+    REQUIRE(dataset->getNumericAttributes() == std::map<std::string, bool>{ { "s", false }, { "n", true } });
+}
+TEST_CASE("Column statistics", "[ArffFiles]")
+{
+    auto threads = GENERATE(1, 4);
+    ArffFiles arff;
+    arff.setThreads(threads);
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    const auto& columns = arff.getColumnStats();
+    const auto& X = arff.getX();
+    REQUIRE(columns.size() == arff.getAttributes().size());
+    auto numeric = arff.getNumericAttributes();
+    size_t missing = 0;
+    for (size_t i = 0; i < columns.size(); i++) {
+        const auto& column = columns[i];
+        INFO("Attribute " << arff.getAttributes()[i].first);
+        REQUIRE(column.count == arff.getSize());
+        missing += column.missing;
+        if (numeric[arff.getAttributes()[i].first]) {
+            double sum = 0;
+            for (auto value : X[i])
+                sum += value;
+            double mean = sum / X[i].size();
+            double m2 = 0;
+            for (auto value : X[i])
+                m2 += (value - mean) * (value - mean);
+            REQUIRE(column.min == *std::min_element(X[i].begin(), X[i].end()));
+            REQUIRE(column.max == *std::max_element(X[i].begin(), X[i].end()));
+            REQUIRE(column.mean == Catch::Approx(mean).epsilon(1e-9));
+            REQUIRE(column.variance() == Catch::Approx(m2 / (X[i].size() - 1)).epsilon(1e-9));
+            REQUIRE(column.frequencies.empty());
+        } else {
+            std::vector<size_t> frequencies(arff.getStates()[arff.getAttributes()[i].first].size());
+            for (auto value : X[i])
+                frequencies[static_cast<size_t>(value)]++;
+            REQUIRE(column.frequencies == frequencies);
+        }
+    }
+    // Only workclass, occupation and native-country have missing values
+    REQUIRE(columns[1].missing == 2799);
+    REQUIRE(columns[6].missing == 2809);
+    REQUIRE(columns[13].missing == 857);
+    REQUIRE(missing == 2799 + 2809 + 857);
+    const auto& label = arff.getClassStats();
+    REQUIRE(label.count == 45222);
+    REQUIRE(label.missing == 0);
+    REQUIRE(label.frequencies.size() == 2);
+    REQUIRE(label.frequencies[0] + label.frequencies[1] == 45222);
+    REQUIRE(std::count(arff.getY().begin(), arff.getY().end(), 0) == static_cast<long>(label.frequencies[0]));
+}
+TEST_CASE("Scaling", "[ArffFiles]")
+{
+    auto mode = GENERATE(ArffScaling::MinMax, ArffScaling::ZScore);
+    ArffFiles raw;
+    raw.load(Paths::datasets("adult"), std::string("class"));
+    ArffFiles arff;
+    arff.setScaling(mode);
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    auto numeric = arff.getNumericAttributes();
+    const auto& X = arff.getX();
+    for (size_t i = 0; i < X.size(); i++) {
+        auto name = arff.getAttributes()[i].first;
+        INFO("Attribute " << name);
+        if (!numeric[name]) {
+            REQUIRE(X[i] == raw.getX()[i]);
+            continue;
+        }
+        double sum = 0;
+        double squares = 0;
+        for (auto value : X[i]) {
+            sum += value;
+            squares += static_cast<double>(value) * value;
+        }
+        double mean = sum / X[i].size();
+        double deviation = std::sqrt(squares / X[i].size() - mean * mean);
+        const auto& column = arff.getColumnStats()[i];
+        if (mode == ArffScaling::MinMax) {
+            REQUIRE(*std::min_element(X[i].begin(), X[i].end()) == Catch::Approx(0).margin(1e-6));
+            REQUIRE(*std::max_element(X[i].begin(), X[i].end()) == Catch::Approx(1).margin(1e-6));
+            REQUIRE(column.min == Catch::Approx(0).margin(1e-6));
+            REQUIRE(column.max == Catch::Approx(1).margin(1e-6));
+        } else {
+            REQUIRE(mean == Catch::Approx(0).margin(1e-5));
+            REQUIRE(deviation == Catch::Approx(1).epsilon(1e-4));
+            REQUIRE(column.mean == Catch::Approx(0).margin(1e-9));
+            REQUIRE(column.m2 / column.count == Catch::Approx(1).epsilon(1e-9));
+        }
+    }
+    // The same transform done afterwards with the parameters returned
+    auto transform = raw.scale(mode);
+    REQUIRE(raw.getX() == arff.getX());
+    REQUIRE(transform[0].first > 0);
+    REQUIRE(transform[1] == std::pair<float, float>(1.0f, 0.0f));
+    REQUIRE(arff.getLoadStats().scaleSeconds >= 0);
+    REQUIRE_THROWS_AS(arff.refresh(), std::logic_error);
+}
+TEST_CASE("Scaling kernels", "[ArffFiles]")
+{
+    std::vector<float> values(1000 + 13);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = static_cast<float>(i) * 0.37f - 100.0f;
+    auto expected = values;
+    arffAffineScalar(expected.data(), expected.size(), 0.25f, 3.0f);
+    auto check = [&](void (*kernel)(float*, size_t, float, float)) {
+        for (size_t size : { size_t(0), size_t(7), size_t(16), size_t(31), values.size() }) {
+            auto result = values;
+            kernel(result.data(), size, 0.25f, 3.0f);
+            size_t wrong = 0;
+            for (size_t i = 0; i < result.size(); i++) {
+                wrong += result[i] != Catch::Approx(i < size ? expected[i] : values[i]);
+            }
+            REQUIRE(wrong == 0);
+        }
+    };
+    check(arffAffine);
+#ifdef ARFFFILES_X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        check(arffAffineAvx2);
+    if (__builtin_cpu_supports("avx512f"))
+        check(arffAffineAvx512);
+#endif
+}
+TEST_CASE("Discretization", "[ArffFiles]")
+{
+    ArffFiles raw;
+    raw.load(Paths::datasets("iris"));
+    SECTION("Equal width")
+    {
+        ArffFiles arff;
+        arff.load(Paths::datasets("iris"));
+        auto cuts = arff.discretize(ArffDiscretization::EqualWidth, 3);
+        // sepallength goes from 4.3 to 7.9
+        REQUIRE(cuts[0].size() == 2);
+        REQUIRE(cuts[0][0] == Catch::Approx(5.5));
+        REQUIRE(cuts[0][1] == Catch::Approx(6.7));
+        REQUIRE(arff.getStates()["sepallength"] == ArffDiscretizer::intervals(cuts[0]));
+        REQUIRE(arff.getStates()["sepallength"][0] == "(-inf;5.5)");
+        for (size_t i = 0; i < raw.getX()[0].size(); i++) {
+            float value = raw.getX()[0][i];
+            REQUIRE(arff.getX()[0][i] == (value < cuts[0][0] ? 0 : value < cuts[0][1] ? 1 : 2));
+        }
+        REQUIRE_THROWS_AS(arff.refresh(), std::logic_error);
+    }
+    SECTION("Equal frequency")
+    {
+        ArffFiles arff;
+        arff.load(Paths::datasets("iris"));
+        auto cuts = arff.discretize(ArffDiscretization::EqualFrequency, 4);
+        for (size_t i = 0; i < cuts.size(); i++) {
+            REQUIRE(std::is_sorted(cuts[i].begin(), cuts[i].end()));
+            const auto& frequencies = arff.getColumnStats()[i].frequencies;
+            REQUIRE(frequencies.size() == cuts[i].size() + 1);
+            // Ties may move some samples to the next bin
+            for (auto frequency : frequencies) {
+                REQUIRE(frequency > 0);
+                REQUIRE(frequency <= 75);
+            }
+        }
+    }
+    SECTION("MDLP")
+    {
+        ArffFiles arff;
+        arff.load(Paths::datasets("iris"));
+        auto cuts = arff.discretize(ArffDiscretization::MDLP);
+        REQUIRE(cuts[2] == std::vector<float>{ 2.45f, 4.75f });
+        REQUIRE(cuts[3] == std::vector<float>{ 0.8f, 1.75f });
+        auto numeric = arff.getNumericAttributes();
+        for (const auto& [name, isNumeric] : numeric) {
+            REQUIRE_FALSE(isNumeric);
+        }
+        // Saved as nominal attributes and read back the same
+        auto fileName = std::string("test_discretized.arff");
+        arff.save(fileName);
+        ArffFiles reloaded;
+        reloaded.load(fileName);
+        // Codes follow the order of appearance when loading, the labels are the same
+        auto states = arff.getStates();
+        auto reloadedStates = reloaded.getStates();
+        for (size_t i = 0; i < arff.getX().size(); i++) {
+            auto name = arff.getAttributes()[i].first;
+            for (size_t row = 0; row < arff.getX()[i].size(); row++) {
+                REQUIRE(reloadedStates[name][static_cast<size_t>(reloaded.getX()[i][row])] == states[name][static_cast<size_t>(arff.getX()[i][row])]);
+            }
+        }
+        std::remove(fileName.c_str());
+    }
+}
+TEST_CASE("Discretizer", "[ArffFiles]")
+{
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    std::vector<std::vector<float>> X = { { 1, 2, missing, 3, 4, 5, 6, 7, 8 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1 } };
+    std::vector<int> y = { 0, 0, 0, 0, 1, 1, 1, 1, 1 };
+    REQUIRE_THROWS_AS(ArffDiscretizer(ArffDiscretization::EqualWidth, 0), std::invalid_argument);
+    ArffDiscretizer discretizer(ArffDiscretization::EqualFrequency, 2);
+    discretizer.setThreads(2).fit(X, y, { true, false });
+    REQUIRE(discretizer.getCutPoints()[0] == std::vector<float>{ 5 });
+    REQUIRE(discretizer.getCutPoints()[1].empty());
+    auto result = discretizer.transform(X);
+    REQUIRE(std::isnan(result[0][2]));
+    REQUIRE(std::vector<float>(result[0].begin() + 3, result[0].end()) == std::vector<float>{ 0, 0, 1, 1, 1, 1 });
+    REQUIRE(result[1] == X[1]);
+    REQUIRE_THROWS_AS(discretizer.transform({ X[0] }), std::invalid_argument);
+    // A single cut between the classes
+    ArffDiscretizer mdlp(ArffDiscretization::MDLP);
+    auto labels = std::vector<int>(40, 0);
+    std::vector<std::vector<float>> values(1);
+    for (size_t i = 0; i < labels.size(); i++) {
+        values[0].push_back(static_cast<float>(i));
+        labels[i] = i < 20 ? 0 : 1;
+    }
+    REQUIRE(mdlp.fit(values, labels).getCutPoints()[0] == std::vector<float>{ 19.5f });
+    REQUIRE(ArffDiscretizer::intervals({}) == std::vector<std::string>{ "(-inf;inf)" });
+}
+TEST_CASE("Stratified splits", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.load(Paths::datasets("iris"));
+    const auto& y = arff.getY();
+    auto folds = arff.stratifiedKFold(5, 42);
+    REQUIRE(folds.size() == 5);
+    std::vector<int> timesTested(y.size(), 0);
+    for (const auto& fold : folds) {
+        REQUIRE(fold.test.size() == 30);
+        REQUIRE(fold.train.size() == 120);
+        REQUIRE(std::is_sorted(fold.test.begin(), fold.test.end()));
+        std::vector<int> perClass(3, 0);
+        for (auto row : fold.test) {
+            timesTested[row]++;
+            perClass[y[row]]++;
+        }
+        REQUIRE(perClass == std::vector<int>{ 10, 10, 10 });
+        std::vector<size_t> all;
+        std::merge(fold.train.begin(), fold.train.end(), fold.test.begin(), fold.test.end(), std::back_inserter(all));
+        REQUIRE(std::adjacent_find(all.begin(), all.end()) == all.end());
+    }
+    REQUIRE(std::all_of(timesTested.begin(), timesTested.end(), [](int times) { return times == 1; }));
+    REQUIRE(arff.stratifiedKFold(5, 42)[0].test == folds[0].test);
+    REQUIRE(arff.stratifiedKFold(5, 7)[0].test != folds[0].test);
+    REQUIRE_THROWS_AS(arff.stratifiedKFold(1), std::invalid_argument);
+    auto split = arff.trainTestSplit(0.2, 3);
+    REQUIRE(split.test.size() == 30);
+    REQUIRE(split.train.size() == 120);
+    REQUIRE(std::count_if(split.test.begin(), split.test.end(), [&y](size_t row) { return y[row] == 2; }) == 10);
+    REQUIRE(arff.trainTestSplit(0.2, 3, false).test.size() == 30);
+    REQUIRE_THROWS_AS(arff.trainTestSplit(1.0), std::invalid_argument);
+    // Views read the rows in place and gather them on demand
+    auto view = arff.view(split.test);
+    REQUIRE(view.size() == 30);
+    REQUIRE(view.features() == 4);
+    REQUIRE(view(2, 5) == arff.getX()[2][split.test[5]]);
+    REQUIRE(view.label(29) == y[split.test[29]]);
+    auto X = view.setThreads(3).gatherX();
+    auto labels = view.gatherY();
+    for (size_t i = 0; i < split.test.size(); i++) {
+        REQUIRE(labels[i] == y[split.test[i]]);
+        for (size_t feature = 0; feature < X.size(); feature++)
+            REQUIRE(X[feature][i] == arff.getX()[feature][split.test[i]]);
+    }
+    auto owned = ArffView(arff.getDataset(), { 0, 149 });
+    REQUIRE(owned.gatherY() == std::vector<int>{ y[0], y[149] });
+    REQUIRE_THROWS_AS(arff.view({ 150 }), std::out_of_range);
+}
+TEST_CASE("Sampling", "[ArffFiles]")
+{
+    ArffFiles full;
+    full.load(Paths::datasets("adult"), std::string("class"));
+    ArffFiles arff;
+    arff.collectStats(true);
+    arff.setSampling(ArffSampling::Uniform, 1000, 11);
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    REQUIRE(arff.getY().size() == 1000);
+    REQUIRE(arff.getLoadStats().rowsKept == 1000);
+    REQUIRE(arff.getLoadStats().rowsBeforeSampling == full.getY().size());
+    REQUIRE_THROWS_AS(arff.refresh(), std::logic_error);
+    // The sample keeps the order of the file
+    size_t row = 0;
+    for (size_t i = 0; i < arff.getY().size(); i++) {
+        auto matches = [&](size_t candidate) {
+            for (size_t feature = 0; feature < full.getX().size(); feature++) {
+                auto name = full.getAttributes()[feature].first;
+                if (full.getNumericAttributes()[name] && full.getX()[feature][candidate] != arff.getX()[feature][i])
+                    return false;
+            }
+            return true;
+        };
+        while (row < full.getY().size() && !matches(row))
+            row++;
+        REQUIRE(row < full.getY().size());
+        row++;
+    }
+    ArffFiles same;
+    same.setSampling(ArffSampling::Uniform, 1000, 11);
+    same.load(Paths::datasets("adult"), std::string("class"));
+    REQUIRE(same.getX() == arff.getX());
+    same.setSampling(ArffSampling::Uniform, 1000, 12);
+    same.load(Paths::datasets("adult"), std::string("class"));
+    REQUIRE(same.getX() != arff.getX());
+    // More rows than the file has
+    same.setSampling(ArffSampling::Uniform, 1000);
+    same.load(Paths::datasets("iris"));
+    REQUIRE(same.getY().size() == 150);
+    REQUIRE_THROWS_AS(same.setSampling(ArffSampling::Uniform, 0), std::invalid_argument);
+    // Memory follows the sample, rows replaced by longer ones give theirs back
+    std::string text = "@relation grow\n@attribute a numeric\n@attribute text {x}\n@attribute class {yes,no}\n@data\n";
+    for (size_t i = 0; i < 50000; i++) {
+        text += std::to_string(i) + "," + std::string(1 + i / 100, 'x') + ",yes\n";
+    }
+    same.collectStats(true);
+    same.setSampling(ArffSampling::Uniform, 50, 3);
+    same.loadFromBuffer(text);
+    REQUIRE(same.getY().size() == 50);
+    REQUIRE(same.getLoadStats().peakAllocatedBytes < text.size() / 20);
+}
+TEST_CASE("Stratified sampling", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.setSampling(ArffSampling::Stratified, 30, 5);
+    arff.load(Paths::datasets("iris"));
+    auto counts = std::vector<int>(3, 0);
+    for (auto label : arff.getY())
+        counts[label]++;
+    REQUIRE(counts == std::vector<int>{ 10, 10, 10 });
+    // The class first
+    arff.loadFromBuffer("@relation s\n@attribute class {a,b}\n@attribute x numeric\n@data\na,1\na,2\na,3\nb,4\na,5\na,6\nb,7\na,8\n", false);
+    REQUIRE(arff.getY().size() == 8);
+    arff.setSampling(ArffSampling::Stratified, 4, 1);
+    arff.loadFromBuffer("@relation s\n@attribute class {a,b}\n@attribute x numeric\n@data\na,1\na,2\na,3\nb,4\na,5\na,6\nb,7\na,8\n", false);
+    REQUIRE(arff.getY().size() == 4);
+    REQUIRE(std::count(arff.getY().begin(), arff.getY().end(), 1) == 1);
+    REQUIRE(std::is_sorted(arff.getX()[0].begin(), arff.getX()[0].end()));
+    ArffReservoir reservoir(2, 3);
+    REQUIRE(reservoir.offer() == 0);
+    REQUIRE(reservoir.offer() == 1);
+    for (int i = 0; i < 100; i++) {
+        auto slot = reservoir.offer();
+        REQUIRE((slot < 2 || slot == ArffReservoir::npos));
+    }
+    REQUIRE(reservoir.seen() == 102);
+    REQUIRE(reservoir.select().size() == 2);
+}
+TEST_CASE("Quantile sketches and histograms", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.setThreads(GENERATE(1, 3));
+    arff.setQuantileSketches(200);
+    arff.setHistogram("age", 8, 10, 90);
+    arff.setHistogram("workclass", 4, 0, 4);
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    auto index = 0;
+    const auto& attributes = arff.getAttributes();
+    for (size_t i = 0; i < attributes.size(); i++) {
+        if (attributes[i].first == "age")
+            index = static_cast<int>(i);
+    }
+    auto values = arff.getX()[index];
+    std::sort(values.begin(), values.end());
+    const auto& sketch = arff.getQuantileSketch("age");
+    REQUIRE(sketch.count() == values.size());
+    REQUIRE(sketch.size() < 2000);
+    REQUIRE(sketch.min() == values.front());
+    REQUIRE(sketch.max() == values.back());
+    for (double q : { 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99 }) {
+        INFO("Quantile " << q);
+        // Rank error within a few times 1 / k
+        auto value = sketch.quantile(q);
+        double low = static_cast<double>(std::lower_bound(values.begin(), values.end(), value) - values.begin()) / values.size();
+        double high = static_cast<double>(std::upper_bound(values.begin(), values.end(), value) - values.begin()) / values.size();
+        REQUIRE(low <= q + 0.03);
+        REQUIRE(high >= q - 0.03);
+        REQUIRE(sketch.rank(value) == Catch::Approx(high).margin(0.03));
+    }
+    const auto& histogram = arff.getHistogram("age");
+    REQUIRE(histogram.bins() == 8);
+    REQUIRE(histogram.edge(1) == 20);
+    size_t total = histogram.getUnderflow() + histogram.getOverflow();
+    for (size_t bin = 0; bin < histogram.bins(); bin++) {
+        auto expected = std::lower_bound(values.begin(), values.end(), histogram.edge(bin + 1)) - std::lower_bound(values.begin(), values.end(), histogram.edge(bin));
+        if (bin + 1 == histogram.bins())
+            expected = std::upper_bound(values.begin(), values.end(), histogram.edge(bin + 1)) - std::lower_bound(values.begin(), values.end(), histogram.edge(bin));
+        REQUIRE(histogram.getCounts()[bin] == static_cast<size_t>(expected));
+        total += histogram.getCounts()[bin];
+    }
+    REQUIRE(total == values.size());
+    REQUIRE_THROWS_AS(arff.getHistogram("workclass"), std::invalid_argument);
+    REQUIRE_THROWS_AS(arff.getQuantileSketch("workclass"), std::invalid_argument);
+    REQUIRE_THROWS_AS(arff.getHistogram("fnlwgt"), std::invalid_argument);
+    // They follow the scaling
+    arff.scale(ArffScaling::MinMax);
+    REQUIRE(arff.getQuantileSketch("age").min() == Catch::Approx(0));
+    REQUIRE(arff.getQuantileSketch("age").max() == Catch::Approx(1));
+    REQUIRE(arff.getHistogram("age").getHigh() == Catch::Approx((90.0 - values.front()) / (values.back() - values.front())));
+}
+TEST_CASE("Sketch merge", "[ArffFiles]")
+{
+    ArffQuantileSketch whole(100), left(100, 1), right(100, 2);
+    for (int i = 0; i < 100000; i++) {
+        float value = static_cast<float>((i * 7919) % 100000);
+        whole.add(value);
+        (i % 2 == 0 ? left : right).add(value);
+    }
+    left.merge(right);
+    REQUIRE(left.count() == 100000);
+    REQUIRE(left.min() == 0);
+    REQUIRE(left.max() == 99999);
+    REQUIRE(left.quantile(0.5) == Catch::Approx(50000).margin(3000));
+    REQUIRE(whole.quantile(0.9) == Catch::Approx(90000).margin(3000));
+    REQUIRE(whole.quantiles({ 0, 1 }) == std::vector<float>{ 0, 99999 });
+    REQUIRE_THROWS_AS(ArffQuantileSketch().quantile(0.5), std::logic_error);
+    ArffHistogram a(4, 0, 1), b(4, 0, 1);
+    a.add(0.1f);
+    b.add(1.0f);
+    b.add(-1.0f);
+    a.merge(b);
+    REQUIRE(a.getCounts() == std::vector<size_t>{ 1, 0, 0, 1 });
+    REQUIRE(a.getUnderflow() == 1);
+    REQUIRE_THROWS_AS(a.merge(ArffHistogram(3, 0, 1)), std::invalid_argument);
+    REQUIRE_THROWS_AS(ArffHistogram(4, 1, 1), std::invalid_argument);
+}
+TEST_CASE("Contingency tables", "[ArffFiles]")
+{
+    std::vector<float> a = { 0, 0, 1, 1, 2 };
+    std::vector<int> b = { 0, 1, 0, 1, 1 };
+    auto table = ArffContingency::of(a.data(), 3, b.data(), 2, a.size());
+    REQUIRE(table.rows() == 3);
+    REQUIRE(table.columns() == 2);
+    REQUIRE(table.getCounts() == std::vector<uint64_t>{ 1, 1, 1, 1, 0, 1 });
+    REQUIRE(table.rowTotals() == std::vector<uint64_t>{ 2, 2, 1 });
+    REQUIRE(table.columnTotals() == std::vector<uint64_t>{ 2, 3 });
+    REQUIRE(table.degreesOfFreedom() == 2);
+    std::vector<int> same = { 0, 0, 1, 1 };
+    auto identical = ArffContingency::of(same.data(), 2, same.data(), 2, same.size());
+    REQUIRE(identical.mutualInformation() == Catch::Approx(std::log(2.0)));
+    REQUIRE(identical.chiSquare() == Catch::Approx(4));
+    std::vector<int> other = { 0, 1, 0, 1 };
+    auto independent = ArffContingency::of(same.data(), 2, other.data(), 2, same.size());
+    REQUIRE(independent.mutualInformation() == Catch::Approx(0).margin(1e-12));
+    REQUIRE(independent.chiSquare() == Catch::Approx(0).margin(1e-12));
+    REQUIRE_THROWS_AS(ArffContingency::of(a.data(), 2, b.data(), 2, a.size()), std::invalid_argument);
+    // Against plain counting on every nominal attribute of adult
+    ArffFiles arff;
+    arff.setThreads(GENERATE(1, 3));
+    arff.load(Paths::datasets("adult"), std::string("class"));
+    auto tables = arff.contingencies();
+    auto information = arff.mutualInformation();
+    auto states = arff.getStates();
+    const auto& y = arff.getY();
+    for (size_t i = 0; i < tables.size(); i++) {
+        auto name = arff.getAttributes()[i].first;
+        INFO("Attribute " << name);
+        if (arff.getNumericAttributes()[name]) {
+            REQUIRE(tables[i].getCounts().empty());
+            REQUIRE(std::isnan(information[i]));
+            continue;
+        }
+        std::vector<uint64_t> expected(states[name].size() * states[arff.getClassName()].size(), 0);
+        for (size_t row = 0; row < y.size(); row++)
+            expected[static_cast<size_t>(arff.getX()[i][row]) * tables[i].columns() + y[row]]++;
+        REQUIRE(tables[i].getCounts() == expected);
+        REQUIRE(arff.contingency(name).getCounts() == expected);
+        REQUIRE(information[i] > 0);
+        REQUIRE(tables[i].chiSquare() > 0);
+    }
+    auto pair = arff.contingency("workclass", "education");
+    REQUIRE(pair.total() == y.size());
+    REQUIRE(pair.rowTotals() == arff.contingency("workclass").rowTotals());
+    REQUIRE(pair.columnTotals() == arff.contingency("education").rowTotals());
+    REQUIRE_THROWS_AS(arff.contingency("age"), std::invalid_argument);
+    REQUIRE_THROWS_AS(arff.contingency("nothing"), std::invalid_argument);
+}
+TEST_CASE("Instance weights", "[ArffFiles]")
+{
+    const std::string text = "@relation w\n@attribute x numeric\n@attribute c {a,b}\n@attribute class {yes,no}\n@data\n"
+        "1,a,yes,{0.5}\n2,b,no\n3,a,yes, {2}\n4,b,yes\n";
+    ArffFiles arff;
+    arff.loadFromBuffer(text);
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1, 0, 0 });
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 2, 3, 4 });
+    REQUIRE(arff.getWeights() == std::vector<float>{ 0.5f, 1, 2, 1 });
+    // 4 rows, 2 classes: 3 of yes and 1 of no
+    auto balanced = arff.getClassBalancedWeights();
+    REQUIRE(balanced[0] == Catch::Approx(4.0 / 6));
+    REQUIRE(balanced[1] == Catch::Approx(2));
+    // Weights are written back and the class is still found when stratifying
+    std::ostringstream output;
+    ArffWriter(*arff.getDataset()).setWeights(arff.getWeights()).write(output);
+    REQUIRE(output.str().substr(output.str().find("@data")) == "@data\n1,a,yes,{0.5}\n2,b,no\n3,a,yes,{2}\n4,b,yes\n");
+    ArffFiles sampled;
+    sampled.setSampling(ArffSampling::Stratified, 2, 3);
+    sampled.loadFromBuffer("@relation w\n@attribute x numeric\n@attribute class {yes,no}\n@data\n1,yes,{2}\n2,no,{2}\n3,yes\n4,no\n");
+    REQUIRE(sampled.getY().size() == 2);
+    REQUIRE(sampled.getY()[0] != sampled.getY()[1]);
+    // Rows without weights
+    arff.load(Paths::datasets("iris"));
+    REQUIRE(arff.getWeights() == std::vector<float>(150, 1.0f));
+    REQUIRE(arff.getClassBalancedWeights() == std::vector<float>(150, 1.0f));
+}
+TEST_CASE("Row hashes and deduplication", "[ArffFiles]")
+{
+    const std::string header = "@relation d\n@attribute x numeric\n@attribute c {a,b}\n@attribute class {yes,no}\n@data\n";
+    ArffFiles arff;
+    arff.setRowHashes(true);
+    arff.loadFromBuffer(header + "1,a,yes\n1.0,a,yes,{3}\n-0,b,no\n0,b,no\n1,b,yes\n1,a,no\n");
+    auto hashes = arff.getRowHashes();
+    REQUIRE(hashes.size() == 6);
+    REQUIRE(hashes[0] == hashes[1]);
+    REQUIRE(hashes[2] == hashes[3]);
+    REQUIRE(hashes[0] != hashes[4]);
+    REQUIRE(hashes[0] != hashes[5]);
+    // The first of every group of equal rows stays, with its weight
+    arff.setDeduplicate(true);
+    arff.collectStats(true);
+    arff.loadFromBuffer(header + "1,a,yes\n1.0,a,yes,{3}\n-0,b,no,{2}\n0,b,no\n1,b,yes\n1,a,no\n1,a,yes\n");
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 0, 1, 1 });
+    REQUIRE(arff.getX()[1] == std::vector<float>{ 0, 1, 1, 0 });
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1, 0, 1 });
+    REQUIRE(arff.getWeights() == std::vector<float>{ 1, 2, 1, 1 });
+    REQUIRE(arff.getRowHashes().size() == 4);
+    REQUIRE(arff.getLines() == std::vector<std::string>{ "1,a,yes", "-0,b,no,{2}", "1,b,yes", "1,a,no" });
+    REQUIRE(arff.getLoadStats().rowsKept == 4);
+    REQUIRE(arff.getLoadStats().rowsDuplicated == 3);
+    REQUIRE(arff.getColumnStats()[0].count == 4);
+    REQUIRE(arff.getColumnStats()[0].mean == Catch::Approx(0.75));
+    REQUIRE(arff.getColumnStats()[1].frequencies == std::vector<size_t>{ 2, 2 });
+    REQUIRE(arff.getClassStats().frequencies == std::vector<size_t>{ 2, 2 });
+    // Against the first appearance of every line, with the rows split between threads
+    std::string text = header;
+    std::vector<std::string> unique;
+    std::set<std::string> seen;
+    std::mt19937 random(7);
+    for (int i = 0; i < 40000; i++) {
+        std::string line = std::to_string(random() % 500) + (random() % 2 ? ",a" : ",b") + (random() % 2 ? ",yes" : ",no");
+        text += line + "\n";
+        if (seen.insert(line).second)
+            unique.push_back(line);
+    }
+    arff.setThreads(GENERATE(1, 3));
+    arff.setRowHashes(false);
+    arff.setQuantileSketches(100);
+    arff.loadFromBuffer(text);
+    REQUIRE(arff.getLines() == unique);
+    REQUIRE(arff.getRowHashes().empty());
+    REQUIRE(arff.getLoadStats().rowsDuplicated == 40000 - unique.size());
+    REQUIRE(arff.getQuantileSketch("x").count() == unique.size());
+    ArffFiles reference;
+    reference.loadFromBuffer(header + std::accumulate(unique.begin(), unique.end(), std::string(), [](std::string all, const std::string& line) { return all + line + "\n"; }));
+    REQUIRE(arff.getX() == reference.getX());
+    REQUIRE(arff.getY() == reference.getY());
+    REQUIRE(arff.getColumnStats()[0].mean == Catch::Approx(reference.getColumnStats()[0].mean));
+    // Appended rows are compared with the ones already loaded
+    const std::string fileName = "dedupe_test.arff";
+    {
+        std::ofstream output(fileName, std::ios::binary);
+        output << header << "1,a,yes\n2,b,no\n";
+    }
+    ArffFiles follow;
+    follow.setDeduplicate(true);
+    follow.load(fileName);
+    {
+        std::ofstream output(fileName, std::ios::binary | std::ios::app);
+        output << "2,b,no\n3,a,yes\n1,a,yes\n3,a,yes\n";
+    }
+    REQUIRE(follow.refresh() == 1);
+    REQUIRE(follow.getX()[0] == std::vector<float>{ 1, 2, 3 });
+    REQUIRE(follow.getLoadStats().rowsDuplicated == 3);
+    std::remove(fileName.c_str());
+}
+TEST_CASE("Multiple targets", "[ArffFiles]")
+{
+    const std::string header = "@relation m\n@attribute t1 {x,y}\n@attribute a numeric\n@attribute t2 {p,q,r}\n@attribute b {u,v}\n@attribute class {yes,no}\n@data\n";
+    const std::string rows = "x,1,r,u,yes\ny,2,p,v,no\nx,?,q,u,no\ny,3,q,v,yes,{2}\n";
+    const std::vector<std::string> targets{ "class", "t2", "t1" };
+    ArffFiles arff;
+    arff.loadFromBuffer(header + rows, targets);
+    REQUIRE(arff.getTargets() == targets);
+    REQUIRE(arff.getClassName() == "class");
+    REQUIRE(arff.getAttributes() == std::vector<std::pair<std::string, std::string>>{ { "a", "numeric" }, { "b", "{u,v}" } });
+    REQUIRE(arff.getX()[0] == std::vector<float>{ 1, 2, 3 });
+    REQUIRE(arff.getX()[1] == std::vector<float>{ 0, 1, 1 });
+    REQUIRE(arff.getY() == std::vector<int>{ 0, 1, 0 });
+    // Row after row: class, t2, t1
+    REQUIRE(arff.getYMatrix() == std::vector<int>{ 0, 0, 0, 1, 1, 1, 0, 2, 1 });
+    REQUIRE(arff.getStates()["t2"] == std::vector<std::string>{ "r", "p", "q" });
+    REQUIRE(arff.getStates()["t1"] == std::vector<std::string>{ "x", "y" });
+    REQUIRE(arff.getWeights() == std::vector<float>{ 1, 1, 2 });
+    REQUIRE(arff.getColumnStats()[0].missing == 1);
+    REQUIRE(arff.getColumnStats()[1].missing == 0);
+    // Rows that differ in a target only aren't duplicates
+    arff.setDeduplicate(true);
+    arff.loadFromBuffer(header + rows + "x,1,p,u,yes\nx,1,r,u,yes\n", targets);
+    REQUIRE(arff.getYMatrix() == std::vector<int>{ 0, 0, 0, 1, 1, 1, 0, 2, 1, 0, 1, 0 });
+    REQUIRE(arff.getLoadStats().rowsDuplicated == 1);
+    // Other loads have no target matrix
+    arff.loadFromBuffer(header + rows, std::string("class"));
+    REQUIRE(arff.getTargets().empty());
+    REQUIRE(arff.getYMatrix().empty());
+    REQUIRE_THROWS_AS(arff.loadFromBuffer(header + rows, std::vector<std::string>()), std::invalid_argument);
+    REQUIRE_THROWS_AS(arff.loadFromBuffer(header + rows, std::vector<std::string>{ "class", "nothing" }), std::invalid_argument);
+    REQUIRE_THROWS_AS(arff.loadFromBuffer(header + rows, std::vector<std::string>{ "class", "t1", "class" }), std::invalid_argument);
+    // Each column the same as a load with that target as the class
+    const std::vector<std::string> adultTargets{ "class", "sex", "race", "workclass" };
+    ArffFiles adult;
+    adult.setThreads(GENERATE(1, 3));
+    adult.load(Paths::datasets("adult"), adultTargets);
+    const auto& Y = adult.getYMatrix();
+    REQUIRE(adult.getX().size() == 11);
+    for (size_t k = 0; k < adultTargets.size(); k++) {
+        ArffFiles single;
+        single.load(Paths::datasets("adult"), adultTargets[k]);
+        REQUIRE(Y.size() == single.getY().size() * adultTargets.size());
+        std::vector<int> column;
+        for (size_t row = k; row < Y.size(); row += adultTargets.size())
+            column.push_back(Y[row]);
+        REQUIRE(column == single.getY());
+        REQUIRE(adult.getStates()[adultTargets[k]] == single.getLabels());
+    }
+    // Appended rows extend every target
+    const std::string fileName = "targets_test.arff";
+    {
+        std::ofstream output(fileName, std::ios::binary);
+        output << header << rows;
+    }
+    ArffFiles follow;
+    follow.load(fileName, targets);
+    {
+        std::ofstream output(fileName, std::ios::binary | std::ios::app);
+        output << "x,4,p,u,no\n";
+    }
+    REQUIRE(follow.refresh() == 1);
+    REQUIRE(follow.getYMatrix() == std::vector<int>{ 0, 0, 0, 1, 1, 1, 0, 2, 1, 1, 1, 0 });
+    // Asynchronous and cached loads
+    ArffFiles later;
+    later.loadAsync(fileName, targets).get();
+    REQUIRE(later.getYMatrix() == follow.getYMatrix());
+    ArffCache cache;
+    auto dataset = cache.load(fileName, targets);
+    REQUIRE(dataset->getTargets() == targets);
+    REQUIRE(dataset->getYMatrix() == follow.getYMatrix());
+    REQUIRE(dataset->getX() == follow.getX());
+    REQUIRE(cache.load(fileName, targets) == dataset);
+    REQUIRE(cache.load(fileName, std::vector<std::string>{ targets[1], targets[0] }) != dataset);
+    REQUIRE(follow.getDataset()->getYMatrix() == follow.getYMatrix());
+    std::remove(fileName.c_str());
+}
+TEST_CASE("Histograms with several threads", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.setThreads(5);
+    arff.setHistogram("age", 10, 20, 70);
+    arff.setHistogram("fnlwgt", 16, 0, 1000000);
+    arff.setHistogram("hours-per-week", 7, 1, 99);
+    const std::vector<std::string> names{ "age", "fnlwgt", "hours-per-week" };
+    for (int load = 0; load < 3; load++) {
+        arff.load(Paths::datasets("adult"), std::string("class"));
+        REQUIRE(arff.getLoadStats().threads > 1);
+        const auto attributes = arff.getAttributes();
+        for (const auto& name : names) {
+            INFO("Attribute " << name);
+            const auto& histogram = arff.getHistogram(name);
+            size_t column = std::find_if(attributes.begin(), attributes.end(), [&name](const auto& attribute) { return attribute.first == name; }) - attributes.begin();
+            const auto& counts = histogram.getCounts();
+            size_t total = std::accumulate(counts.begin(), counts.end(), size_t(0)) + histogram.getUnderflow() + histogram.getOverflow();
+            REQUIRE(total == arff.getY().size());
+            // Every batch counted once, the same counts as a single histogram over the column
+            ArffHistogram reference(histogram.bins(), histogram.getLow(), histogram.getHigh());
+            reference.add(arff.getX()[column].data(), arff.getX()[column].size());
+            REQUIRE(counts == reference.getCounts());
+            REQUIRE(histogram.getOverflow() == reference.getOverflow());
+        }
+    }
+}
+TEST_CASE("Progress of compressed files", "[ArffFiles]")
+{
+#ifdef ARFFFILES_USE_ZLIB
+    auto fileName = Paths::datasets("glass") + ".gz";
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<std::pair<size_t, size_t>> calls;
+    ArffFiles arff;
+    arff.setProgressCallback([&](size_t bytesRead, size_t totalBytes, size_t) { calls.emplace_back(bytesRead, totalBytes); }, 10);
+    arff.load(fileName, std::string("Type"));
+    REQUIRE(calls.size() > 5);
+    for (size_t i = 0; i < calls.size(); i++) {
+        REQUIRE(calls[i].second == fileSize);
+        REQUIRE(calls[i].first > 0);
+        REQUIRE(calls[i].first <= fileSize);
+        REQUIRE((i == 0 || calls[i].first >= calls[i - 1].first));
+    }
+    REQUIRE(calls.back().first == fileSize);
+#endif
+}
+TEST_CASE("Progress of streams", "[ArffFiles]")
+{
+    std::ifstream file(Paths::datasets("adult"), std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::istringstream stream(content);
+    std::vector<std::pair<size_t, size_t>> calls;
+    ArffFiles arff;
+    arff.setProgressCallback([&](size_t bytesRead, size_t totalBytes, size_t) { calls.emplace_back(bytesRead, totalBytes); }, 1000);
+    arff.loadFromStream(stream, std::string("class"));
+    // The size of a stream isn't known, the bytes still go up
+    REQUIRE(calls.size() > 40);
+    for (size_t i = 0; i + 1 < calls.size(); i++) {
+        REQUIRE(calls[i].second == 0);
+        REQUIRE((i == 0 || calls[i].first > calls[i - 1].first));
+    }
+    REQUIRE(calls.front().first > 0);
+    REQUIRE(calls.back().first == calls.back().second);
+    REQUIRE(calls.back().first >= content.size() - 1);
+}
+TEST_CASE("Scaling a constant column", "[ArffFiles]")
+{
+    ArffFiles arff;
+    arff.setHistogram("a", 4, 0, 8);
+    arff.setHistogram("b", 4, 0, 8);
+    arff.loadFromBuffer("@relation c\n@attribute a numeric\n@attribute b numeric\n@attribute class {x,y}\n@data\n"
+        "5,1,x\n5,3,y\n5,7,x\n5,9,y\n");
+    REQUIRE(arff.getHistogram("a").getCounts() == std::vector<size_t>{ 0, 0, 4, 0 });
+    auto transform = arff.scale(GENERATE(ArffScaling::MinMax, ArffScaling::ZScore));
+    REQUIRE(transform[0].first == 0);
+    REQUIRE(arff.getX()[0] == std::vector<float>(4, 0));
+    // Every value is 0 now, and so is the histogram
+    const auto& histogram = arff.getHistogram("a");
+    REQUIRE(histogram.getLow() == 0);
+    REQUIRE(histogram.getHigh() > 0);
+    REQUIRE(histogram.getCounts() == std::vector<size_t>{ 4, 0, 0, 0 });
+    REQUIRE(histogram.getUnderflow() + histogram.getOverflow() == 0);
+    ArffHistogram reference(histogram.bins(), histogram.getLow(), histogram.getHigh());
+    reference.add(arff.getX()[0].data(), arff.getX()[0].size());
+    REQUIRE(histogram.getCounts() == reference.getCounts());
+    // A column that isn't constant keeps its counts, with the range mapped
+    const auto& other = arff.getHistogram("b");
+    REQUIRE(other.getLow() == Catch::Approx(0 * transform[1].first + transform[1].second));
+    REQUIRE(std::accumulate(other.getCounts().begin(), other.getCounts().end(), size_t(0)) + other.getOverflow() == 4);
+}